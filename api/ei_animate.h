@@ -0,0 +1,76 @@
+/**
+ *  @file	ei_animate.h
+ *  @brief	Animation of the placer parameters of widgets. All the running animations are
+ *		advanced together, once per frame, by a single periodic timer (see ei_timer.h)
+ *		that only runs while something is animated: each frame costs one placement per
+ *		animated widget and one redraw of the changed areas.
+ *
+ */
+
+#ifndef EI_ANIMATE_H
+#define EI_ANIMATE_H
+
+#include "ei_types.h"
+#include "ei_widget.h"
+
+
+
+/**
+ * \brief	The placer parameters that can be animated (see \ref ei_place).
+ */
+typedef enum {
+	ei_anim_x		= 0,
+	ei_anim_y,
+	ei_anim_width,
+	ei_anim_height,
+	ei_anim_rel_x,
+	ei_anim_rel_y,
+	ei_anim_rel_width,
+	ei_anim_rel_height,
+	ei_anim_last			///< Last property, its value is the number of properties.
+} ei_anim_property_t;
+
+/**
+ * \brief	How the value progresses between the start and the end of an animation.
+ */
+typedef enum {
+	ei_ease_linear		= 0,	///< Constant speed.
+	ei_ease_in,			///< Starts slowly, then accelerates (cubic).
+	ei_ease_out,			///< Starts fast, then decelerates (cubic).
+	ei_ease_in_out			///< Accelerates, then decelerates (cubic).
+} ei_easing_t;
+
+/**
+ * \brief	Animates a placer parameter of a widget from its current value to "to". An
+ *		animation of the same parameter of the same widget is replaced, the new one
+ *		starting from the value reached so far.
+ *
+ * @param	widget		The widget, which must have been placed (see \ref ei_place).
+ * @param	property	The parameter to animate.
+ * @param	to		The final value. Integer parameters are rounded.
+ * @param	duration_ms	The duration of the animation, in milliseconds. If 0 or less, the
+ *				final value is set right away.
+ * @param	easing		The progression of the value.
+ */
+void ei_animate(ei_widget_t widget, ei_anim_property_t property, float to, int duration_ms, ei_easing_t easing);
+
+/**
+ * \brief	Stops the animations of a widget, leaving its parameters at the value reached.
+ *		Called by \ref ei_widget_destroy and \ref ei_placer_forget.
+ *
+ * @param	widget		The widget.
+ */
+void ei_animate_cancel(ei_widget_t widget);
+
+/**
+ * \brief	Tells if a widget has running animations.
+ *
+ * @param	widget		The widget.
+ *
+ * @return			true if at least one parameter of the widget is being animated.
+ */
+bool ei_animate_is_running(ei_widget_t widget);
+
+
+
+#endif
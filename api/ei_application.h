@@ -37,6 +37,27 @@
  */
 void ei_app_create(ei_size_t main_window_size, bool fullscreen);
 
+/**
+ * \brief	How \ref ei_widget_pick finds the widget at a given location.
+ */
+typedef enum {
+	ei_picking_offscreen	= 0,	///< Every widget is also drawn with its pick color in an offscreen
+					///  of the size of the root window, picking reads one pixel.
+	ei_picking_geometric		///< No offscreen: picking walks the widget tree from the topmost widget
+					///  down and tests the geometry of each widget (rounded corners of
+					///  buttons included). Saves one window-sized surface and its filling.
+} ei_picking_t;
+
+/**
+ * \brief	Same as \ref ei_app_create, with a choice of the picking method.
+ *		\ref ei_app_create uses \ref ei_picking_offscreen.
+ *
+ * @param	main_window_size	See \ref ei_app_create.
+ * @param	fullScreen		See \ref ei_app_create.
+ * @param	picking			The picking method used for the lifetime of the application.
+ */
+void ei_app_create_with_picking(ei_size_t main_window_size, bool fullscreen, ei_picking_t picking);
+
 /**
  * \brief	Releases all the resources of the application, and releases the hardware
  *		(ie. calls \ref hw_quit).
@@ -46,6 +67,8 @@ void ei_app_free(void);
 /**
  * \brief	Runs the application: enters the main event loop. Exits when
  *		\ref ei_app_quit_request is called.
+ *		All the pending events are handled before each redraw. Of consecutive mouse moves
+ *		aimed at the same widget, only the last one is handled.
  */
 void ei_app_run(void);
 
@@ -80,6 +103,115 @@ ei_widget_t ei_app_root_widget(void);
  */
 ei_surface_t ei_app_root_surface(void);
 
+/**
+ * \brief	Enables or disables the present filter (disabled by default). When enabled, the
+ *		areas redrawn by the main loop are compared, by tiles of 64x64 pixels, with what
+ *		was last presented on screen: the tiles whose pixels did not change are left out
+ *		of \ref hw_surface_update_rects. Useful when presenting is expensive (remote
+ *		display), at the cost of hashing the redrawn tiles.
+ *
+ * @param	enabled		true to enable the filter.
+ */
+void ei_app_set_present_filter(bool enabled);
+
+/**
+ * \brief	Sets the cadence of the redraws of the main loop. In immediate mode (the default,
+ *		frame_rate 0), the invalidated areas are redrawn as soon as the pending events are
+ *		handled: lowest input latency, but a burst of events may trigger more redraws than
+ *		the screen can show. With a frame rate, the events are still handled as they come,
+ *		but the invalidated areas are redrawn and presented at most frame_rate times per
+ *		second (the wake-up is scheduled with \ref hw_event_schedule_app). When a redraw
+ *		takes longer than the frame interval, the next one is delayed by half its duration.
+ *
+ * @param	frame_rate	The maximum number of redraws per second, 0 for immediate mode.
+ */
+void ei_app_set_frame_rate(double frame_rate);
+
+/**
+ * \brief	Limits the time spent in each redraw of the main loop (no limit by default). The
+ *		invalidated areas are cut into tiles of 128x128 pixels, drawn by priority: the tile
+ *		under the mouse pointer first, then the tiles over the window in front (the child of
+ *		the root widget that contains the active widget, or the last one). When the budget
+ *		is spent, the tiles drawn so far are presented and the others are drawn in the next
+ *		iterations of the main loop, after the pending events are handled.
+ *		At least one tile is drawn in each redraw.
+ *
+ * @param	seconds		The time budget of a redraw, measured with \ref hw_now. 0 for no limit.
+ */
+void ei_app_set_redraw_budget(double seconds);
+
+/**
+ * \brief	How the content of a toplevel is shown while it is resized with its resize handle.
+ */
+typedef enum {
+	ei_live_resize_off	= 0,	///< The children are placed again and redrawn at every move of the mouse.
+	ei_live_resize_blit,		///< The last full rendering of the content is copied as is in the new frame.
+	ei_live_resize_stretch		///< The last full rendering of the content is stretched to the new frame
+					///  (nearest neighbour).
+} ei_live_resize_t;
+
+/**
+ * \brief	Sets the live resize mode of the toplevels (\ref ei_live_resize_off by default).
+ *		With a preview mode, the content of a toplevel is rendered once when its resize
+ *		starts, and every move of the mouse only resizes the frame and draws this rendering
+ *		in it. The children are placed again and the content rendered again at most every
+ *		relayout_ms milliseconds, and once when the mouse button is released.
+ *
+ * @param	mode		The live resize mode.
+ * @param	relayout_ms	The minimal delay between two full relayouts during a resize, in milliseconds.
+ */
+void ei_app_set_live_resize(ei_live_resize_t mode, int relayout_ms);
+
+/**
+ * \brief	Allows the toplevels to lower the drawing quality while they are moved or resized
+ *		(allowed by default). Buttons and frames are then drawn as flat rectangles, without
+ *		rounded corners nor relief, and texts are copied from cached renderings without
+ *		blending. The areas drawn this way are drawn again at full quality when the mouse
+ *		button is released, or when the mouse has not moved for a short while.
+ *
+ * @param	reduced		true to allow the reduced quality, false to always draw at full quality.
+ */
+void ei_app_set_interaction_quality(bool reduced);
+
+/**
+ * \brief	Enables the motion prediction of the drags (disabled by default, see ei_drag.h):
+ *		a dragged toplevel is drawn where the pointer is expected to be when the frame
+ *		reaches the screen, extrapolated from the pointer velocity. The expected present
+ *		time is the next redraw (see \ref ei_app_set_frame_rate) plus the duration of the
+ *		last redraw. The exact position is restored when the mouse button is released, or
+ *		when the pointer stops.
+ *
+ * @param	enabled		true to extrapolate the dragged positions.
+ */
+void ei_app_set_motion_prediction(bool enabled);
+
+/**
+ * \brief	Counters of the main loop, since the creation of the application.
+ */
+typedef struct {
+	uint64_t	presented_bytes;	///< Bytes of the root surface sent to the screen.
+	uint64_t	present_bytes_saved;	///< Bytes left out by the present filter (see \ref ei_app_set_present_filter).
+	uint64_t	mouse_moves_dropped;	///< Mouse moves not dispatched: the main loop handles all the pending
+						///  events before redrawing, and only the last of consecutive moves
+						///  sent while the same widget is active (or while none is).
+	uint64_t	frames_presented;	///< Redraws of the invalidated areas (see \ref ei_app_set_frame_rate).
+	uint64_t	redraws_interrupted;	///< Redraws stopped by their time budget (see \ref ei_app_set_redraw_budget).
+	uint64_t	input_latency_us;	///< Sum of the delays, in microseconds, between the reception of an
+						///  input event and the presentation of the next redraw.
+	uint64_t	inputs_presented;	///< Number of delays summed in input_latency_us.
+	uint64_t	drag_lag_px;		///< Sum of the distances, in pixels, between the position drawn during
+						///  a drag, once it is expected on screen, and the exact position for
+						///  the pointer at that time (see \ref ei_app_set_motion_prediction).
+	uint64_t	drag_samples;		///< Number of distances summed in drag_lag_px.
+} ei_app_stats_t;
+
+/**
+ * \brief	Returns the counters of the main loop.
+ *
+ * @param	stats		Where to store the counters.
+ */
+void ei_app_get_stats(ei_app_stats_t* stats);
+
 
 
 
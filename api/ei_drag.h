@@ -0,0 +1,77 @@
+/**
+ *  @file	ei_drag.h
+ *  @brief	Helper for the widgets that follow the mouse pointer (moves, resizes). The drawn
+ *		position can be extrapolated from the pointer velocity to the time the frame is
+ *		expected on screen (see \ref ei_app_set_motion_prediction), which hides the delay
+ *		between a mouse move and its presentation. The exact position is given back when
+ *		the drag ends.
+ *
+ */
+
+#ifndef EI_DRAG_H
+#define EI_DRAG_H
+
+#include "ei_types.h"
+
+
+
+/**
+ * \brief	State of a drag, owned by the dragged widget. The fields are private.
+ */
+typedef struct {
+	ei_point_t	origin;			///< Position of the dragged object when the drag started.
+	ei_point_t	start;			///< Pointer position when the drag started.
+	ei_point_t	pointer;		///< Last pointer position.
+	double		time;			///< Date of the last pointer position (\ref hw_now).
+	float		velocity_x;		///< Estimated pointer velocity, in pixels per second.
+	float		velocity_y;
+	ei_point_t	drawn;			///< Last position returned by \ref ei_drag_update.
+	double		present_time;		///< Date at which drawn is expected on screen.
+	bool		active;			///< true between \ref ei_drag_begin and \ref ei_drag_end.
+} ei_drag_t;
+
+/**
+ * \brief	Starts a drag.
+ *
+ * @param	drag		The state of the drag.
+ * @param	pointer		The pointer position (usually from the button down event).
+ * @param	origin		The position of the dragged object: its top left corner for a move, its
+ *				size for a resize (as a point).
+ */
+void ei_drag_begin(ei_drag_t* drag, ei_point_t pointer, ei_point_t origin);
+
+/**
+ * \brief	Gives the position to draw after a move of the pointer: the origin moved by the
+ *		pointer displacement, extrapolated to the expected present time if the motion
+ *		prediction is enabled.
+ *
+ * @param	drag		The state of the drag.
+ * @param	pointer		The new pointer position.
+ *
+ * @return			The position to draw.
+ */
+ei_point_t ei_drag_update(ei_drag_t* drag, ei_point_t pointer);
+
+/**
+ * \brief	Gives the exact position for the last pointer position, without prediction. It
+ *		is the position to draw when the pointer stops.
+ *
+ * @param	drag		The state of the drag.
+ *
+ * @return			The exact position.
+ */
+ei_point_t ei_drag_position(const ei_drag_t* drag);
+
+/**
+ * \brief	Ends a drag (usually on the button up event).
+ *
+ * @param	drag		The state of the drag.
+ *
+ * @return			The exact position for the last pointer position given to \ref ei_drag_update,
+ *				to which the dragged object must be corrected.
+ */
+ei_point_t ei_drag_end(ei_drag_t* drag);
+
+
+
+#endif
@@ -70,6 +70,25 @@ void		ei_place	(ei_widget_t		widget,
 void		ei_placer_forget(ei_widget_t widget);
 
 
+/**
+ * \brief	Starts a layout transaction: until the matching \ref ei_layout_commit, the placements
+ *		requested by \ref ei_place (and by the configuration functions) are queued instead
+ *		of being computed. Each widget is placed once at the commit, parents before their
+ *		children, and the damaged areas are merged in a single redraw.
+ *		Transactions can be nested: only the outermost commit places the widgets.
+ *		The main loop opens a transaction around the handling of each event.
+ *
+ *		Reading the geometry of a widget (\ref ei_widget_get_screen_location,
+ *		\ref ei_widget_get_content_rect) during a transaction places the queued widgets first.
+ */
+void		ei_layout_begin(void);
+
+/**
+ * \brief	Ends a layout transaction started by \ref ei_layout_begin.
+ */
+void		ei_layout_commit(void);
+
+
 static inline void ei_place_xy		(ei_widget_t widget, int x, int y)			{ ei_place(widget, NULL, &x, &y, NULL, NULL, NULL, NULL, NULL, NULL); }
 static inline void ei_place_anchored_xy	(ei_widget_t widget, ei_anchor_t anchor, int x, int y)	{ ei_place(widget, &anchor, &x, &y, NULL, NULL, NULL, NULL, NULL, NULL); }
 
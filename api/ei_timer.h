@@ -0,0 +1,75 @@
+/**
+ *  @file	ei_timer.h
+ *  @brief	Timers called back from the main loop: one-shot or periodic, optionally owned by
+ *		a widget. All the timers of the application share a single pending hardware timer
+ *		(see \ref hw_event_schedule_app): they are kept in a hierarchical timing wheel, so
+ *		starting and cancelling a timer take constant time.
+ *
+ */
+
+#ifndef EI_TIMER_H
+#define EI_TIMER_H
+
+#include "ei_types.h"
+#include "ei_widget.h"
+
+
+
+/**
+ * \brief	Opaque handle of a timer.
+ */
+typedef struct ei_impl_timer_t* ei_timer_t;
+
+/**
+ * \brief	A function called when a timer expires.
+ *
+ * @param	timer		The timer. A periodic timer may be cancelled from its callback.
+ * @param	user_param	The user parameter given to \ref ei_timer_start.
+ */
+typedef void (*ei_timer_callback_t) (ei_timer_t timer, ei_user_param_t user_param);
+
+/**
+ * \brief	Starts a timer. The callback is called from the main loop (\ref ei_app_run), in
+ *		order of expiry.
+ *
+ * @param	delay_ms	Time before the first call, in milliseconds.
+ * @param	period_ms	Time between the next calls, in milliseconds, or 0 for a one-shot timer.
+ * @param	owner		If not NULL, the timer is cancelled when this widget is destroyed.
+ * @param	callback	The function to call.
+ * @param	user_param	A user parameter that will be passed to the callback.
+ *
+ * @return			The handle of the timer. It stays valid until the timer is cancelled,
+ *				or until the callback of a one-shot timer returns.
+ */
+ei_timer_t ei_timer_start(int			delay_ms,
+			  int			period_ms,
+			  ei_widget_t		owner,
+			  ei_timer_callback_t	callback,
+			  ei_user_param_t	user_param);
+
+/**
+ * \brief	Cancels a timer: its callback will not be called again.
+ *
+ * @param	timer		The timer, see \ref ei_timer_start.
+ */
+void ei_timer_cancel(ei_timer_t timer);
+
+/**
+ * \brief	Cancels all the timers owned by a widget. Called by \ref ei_widget_destroy.
+ *
+ * @param	owner		The widget.
+ */
+void ei_timer_cancel_owner(ei_widget_t owner);
+
+/**
+ * \brief	Sets the tolerance of the timers (0 by default). The expiry of a timer is delayed
+ *		to the next multiple of the tolerance, so that the timers that expire within the
+ *		same window of time are called back together, after a single wake-up.
+ *
+ * @param	tolerance_ms	The tolerance, in milliseconds.
+ */
+void ei_timer_set_tolerance(int tolerance_ms);
+
+
+
+#endif
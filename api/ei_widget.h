@@ -97,6 +97,66 @@ bool	 		ei_widget_is_displayed		(ei_widget_t		widget);
  */
 ei_widget_t		ei_widget_pick			(ei_point_t*		where);
 
+/**
+ * @brief	Requests the redraw of a widget whose appearance changed, but not its geometry
+ *		(e.g. a new color). Cheaper than \ref ei_app_invalidate_rect on its screen location:
+ *		the redraw starts from the nearest ancestor that hides everything behind the
+ *		widget, instead of from the root widget.
+ *
+ * @param	widget		The widget to redraw. Nothing happens if it is not displayed.
+ */
+void			ei_widget_repaint		(ei_widget_t		widget);
+
+/**
+ * @brief	Moves a widget on top of its siblings: it is drawn after them, and picked before
+ *		them where they overlap. Only the parts of the widget that its siblings covered
+ *		are redrawn. Does nothing if the widget is already on top.
+ *
+ * @param	widget		The widget to raise.
+ */
+void			ei_widget_bring_to_front	(ei_widget_t		widget);
+
+/**
+ * @brief	Keeps the rendering of a widget and of its descendants in an offscreen buffer,
+ *		which is copied back to the screen on the next redraws instead of calling the
+ *		draw functions again. Moving the widget does not discard the buffer, changing
+ *		its size or the geometry of its descendants does.
+ *		Only widgets that are opaque over their whole screen location use their buffer.
+ *
+ *		The library discards the buffer when it changes a widget of the subtree (configure,
+ *		placement, creation, destruction). Widgets of other classes whose rendering changes
+ *		without these calls must call \ref ei_widget_repaint.
+ *
+ * @param	widget		The widget.
+ * @param	cached		true to keep a buffer, false to free it.
+ */
+void			ei_widget_set_cached		(ei_widget_t		widget,
+							 bool			cached);
+
+/**
+ * @brief	Renders a child of the root widget, typically a toplevel, in its own layer. The
+ *		background (the root widget and its other children) is then kept in a layer too,
+ *		and the screen is assembled from the layers by z-order: moving a layered widget
+ *		costs copies only, without calling any draw function, and a change in its
+ *		content renders this layer only.
+ *
+ *		Layers use the buffers of \ref ei_widget_set_cached, and share their memory budget.
+ *
+ * @param	widget		A child of the root widget.
+ * @param	layered		true to render it in a layer, false to draw it normally again.
+ */
+void			ei_widget_set_layered		(ei_widget_t		widget,
+							 bool			layered);
+
+/**
+ * @brief	Sets the memory shared by the buffers of all the cached widgets (see
+ *		\ref ei_widget_set_cached). When it is exceeded, the buffers of the least recently
+ *		drawn widgets are freed, and rendered again when needed.
+ *
+ * @param	bytes		The budget, in bytes. Defaults to 32 MB.
+ */
+void			ei_widget_set_cache_budget	(size_t			bytes);
+
 
 
 
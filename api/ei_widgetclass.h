@@ -55,7 +55,15 @@ typedef void	(*ei_widgetclass_releasefunc_t)		(ei_widget_t	widget);
  * @param	widget		A pointer to the widget instance to draw.
  * @param	surface		A locked surface where to draw the widget. The actual location of the widget in the
  *				surface is stored in its "screen_location" field.
- * @param	pick_surface	The picking offscreen.
+ * @param	pick_surface	The picking offscreen, or NULL. It is NULL when the widget is drawn on
+ *				screen: the picking offscreen is drawn separately, by calling the function
+ *				again with the offscreen as pick_surface and a scratch surface, whose
+ *				content is discarded, as surface. The function draws its shape there in
+ *				the color given by \ref ei_widget_get_pick_color, with \ref ei_fill,
+ *				\ref ei_draw_polygon or \ref ei_draw_polyline (\ref ei_draw_text and
+ *				\ref ei_copy_surface ignore it). The children do not need to be drawn
+ *				there. It is not an hw surface: it must not be given to the hw_surface_*
+ *				functions. The functions of ei_draw.h draw nothing on a NULL surface.
  * @param	clipper		If not NULL, the drawing is restricted within this rectangle
  *				(expressed in the surface reference frame).
  */
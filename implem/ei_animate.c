@@ -0,0 +1,205 @@
+#include "ei_animate.h"
+#include "ei_timer.h"
+#include "ei_implementation.h"
+#include "hw_interface.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define EI_ANIMATE_FRAME_MS     16      // Période du timer qui fait avancer les animations
+
+typedef struct animation_t {
+    ei_anim_property_t  property;
+    float               from;
+    float               to;
+    double              start;          // hw_now() au départ
+    double              duration;       // En secondes
+    ei_easing_t         easing;
+    struct animation_t* next;           // Animations du même widget
+} animation_t;
+
+// Un widget animé, chaîné avec les autres widgets animés.
+struct ei_impl_animated_t {
+    ei_widget_t                 widget;
+    animation_t*                animations;
+    struct ei_impl_animated_t*  prev;
+    struct ei_impl_animated_t*  next;
+};
+
+static struct ei_impl_animated_t*   g_animated      = NULL;
+static ei_timer_t                   g_tick          = NULL;  // NULL quand rien n'est animé
+
+
+static float* float_param(ei_impl_placer_params_t* params, ei_anim_property_t property) {
+    switch (property) {
+        case ei_anim_rel_x:         return &params->rel_x;
+        case ei_anim_rel_y:         return &params->rel_y;
+        case ei_anim_rel_width:     return &params->rel_width;
+        case ei_anim_rel_height:    return &params->rel_height;
+        default:                    return NULL;
+    }
+}
+
+static int* int_param(ei_impl_placer_params_t* params, ei_anim_property_t property) {
+    switch (property) {
+        case ei_anim_x:             return &params->x;
+        case ei_anim_y:             return &params->y;
+        case ei_anim_width:         return &params->width;
+        case ei_anim_height:        return &params->height;
+        default:                    return NULL;
+    }
+}
+
+static float get_param(ei_impl_placer_params_t* params, ei_anim_property_t property) {
+    int* value = int_param(params, property);
+    return value != NULL ? (float)*value : *float_param(params, property);
+}
+
+// Retourne true si la valeur a changé.
+static bool set_param(ei_impl_placer_params_t* params, ei_anim_property_t property, float value) {
+    int* int_value = int_param(params, property);
+    bool changed;
+    if (int_value != NULL) {
+        int rounded = (int)lroundf(value);
+        changed = *int_value != rounded;
+        *int_value = rounded;
+    } else {
+        float* float_value = float_param(params, property);
+        changed = *float_value != value;
+        *float_value = value;
+    }
+    params->dirty |= changed;
+    return changed;
+}
+
+static float ease(ei_easing_t easing, float t) {
+    switch (easing) {
+        case ei_ease_in:
+            return t * t * t;
+        case ei_ease_out:
+            return 1 - (1 - t) * (1 - t) * (1 - t);
+        case ei_ease_in_out:
+            return t < 0.5f ? 4 * t * t * t : 1 - 4 * (1 - t) * (1 - t) * (1 - t);
+        default:
+            return t;
+    }
+}
+
+static void animated_free(struct ei_impl_animated_t* animated) {
+    while (animated->animations != NULL) {
+        animation_t* next = animated->animations->next;
+        free(animated->animations);
+        animated->animations = next;
+    }
+    if (animated->prev != NULL) animated->prev->next = animated->next; else g_animated = animated->next;
+    if (animated->next != NULL) animated->next->prev = animated->prev;
+    animated->widget->animated = NULL;
+    free(animated);
+
+    if (g_animated == NULL && g_tick != NULL) {
+        ei_timer_cancel(g_tick);
+        g_tick = NULL;
+    }
+}
+
+// Fait avancer toutes les animations : chaque widget animé est placé une seule fois par image.
+static void tick(ei_timer_t timer, ei_user_param_t user_param) {
+    (void)timer;
+    (void)user_param;
+    double now = hw_now();
+    struct ei_impl_animated_t* animated = g_animated;
+    while (animated != NULL) {
+        struct ei_impl_animated_t* next_animated = animated->next;
+        ei_widget_t widget = animated->widget;
+        ei_impl_placer_params_t* params = widget->placer_params;
+        bool changed = false;
+
+        animation_t** link = &animated->animations;
+        while (*link != NULL) {
+            animation_t* animation = *link;
+            float t = animation->duration > 0 ? (float)((now - animation->start) / animation->duration) : 1;
+            if (t >= 1) {
+                changed |= set_param(params, animation->property, animation->to);
+                *link = animation->next;
+                free(animation);
+                continue;
+            }
+            float progress = ease(animation->easing, t > 0 ? t : 0);
+            changed |= set_param(params, animation->property, animation->from + (animation->to - animation->from) * progress);
+            link = &animation->next;
+        }
+
+        if (changed) {
+            ei_impl_placer_run(widget);
+        }
+        if (animated->animations == NULL) {
+            animated_free(animated);
+        }
+        animated = next_animated;
+    }
+}
+
+void ei_animate(ei_widget_t widget, ei_anim_property_t property, float to, int duration_ms, ei_easing_t easing) {
+    assert(widget != NULL && widget->placer_params != NULL && "The widget must have been placed");
+    assert(property >= 0 && property < ei_anim_last);
+
+    struct ei_impl_animated_t* animated = widget->animated;
+    animation_t* animation = NULL;
+    if (animated != NULL) {
+        for (animation = animated->animations; animation != NULL; animation = animation->next) {
+            if (animation->property == property) {
+                break;
+            }
+        }
+    }
+
+    if (duration_ms <= 0) {
+        if (animation != NULL) {
+            // L'animation en cours se termine sur la nouvelle valeur à la prochaine image
+            animation->to = to;
+            animation->duration = 0;
+        }
+        if (set_param(widget->placer_params, property, to)) {
+            ei_impl_placer_run(widget);
+        }
+        return;
+    }
+
+    if (animated == NULL) {
+        animated = calloc(1, sizeof(struct ei_impl_animated_t));
+        assert(animated != NULL && "Failed to allocate an animation");
+        animated->widget = widget;
+        animated->next = g_animated;
+        if (g_animated != NULL) {
+            g_animated->prev = animated;
+        }
+        g_animated = animated;
+        widget->animated = animated;
+    }
+    if (animation == NULL) {
+        animation = malloc(sizeof(animation_t));
+        assert(animation != NULL && "Failed to allocate an animation");
+        animation->property = property;
+        animation->next = animated->animations;
+        animated->animations = animation;
+    }
+    animation->from = get_param(widget->placer_params, property);
+    animation->to = to;
+    animation->start = hw_now();
+    animation->duration = duration_ms / 1000.0;
+    animation->easing = easing;
+
+    if (g_tick == NULL) {
+        g_tick = ei_timer_start(EI_ANIMATE_FRAME_MS, EI_ANIMATE_FRAME_MS, NULL, tick, NULL);
+    }
+}
+
+void ei_animate_cancel(ei_widget_t widget) {
+    if (widget->animated != NULL) {
+        animated_free(widget->animated);
+    }
+}
+
+bool ei_animate_is_running(ei_widget_t widget) {
+    return widget->animated != NULL;
+}
@@ -4,6 +4,11 @@
 #include "ei_types.h"
 #include "hw_interface.h"
 #include "ei_implementation.h"
+#include "ei_pick_buffer.h"
+#include "ei_widget_cache.h"
+#include "ei_present_filter.h"
+#include "ei_placer.h"
+#include "ei_timer.h"
 #include "ei_draw.h"
 #include "ei_event.h"
 #include "ei_utils.h"
@@ -22,6 +27,56 @@ static ei_widget_t g_root_widget = NULL;
 static bool g_application_quit_request = false;
 static ei_linked_rect_t* g_invalidated_rects_head = NULL;
 
+// Repeintes partielles demandées par ei_widget_repaint : le dessin part de "start" et non de la racine.
+typedef struct repaint_t {
+    ei_linked_rect_t link;      // link.rect : zone à repeindre ; link.next chaîne les repeintes
+    ei_widget_t      start;
+} repaint_t;
+static repaint_t* g_repaints_head = NULL;
+
+// Déplacements de pixels enregistrés par ei_impl_app_move_rect, exécutés dans l'ordre avant tout dessin.
+typedef struct move_t {
+    ei_linked_rect_t link;      // link.rect : destination ; link.next chaîne les déplacements
+    ei_point_t       from;      // Coin haut gauche de la source
+} move_t;
+static move_t* g_moves_head = NULL;
+static move_t* g_moves_tail = NULL;
+
+static ei_app_stats_t g_stats = {0};
+static char g_drain_marker;     // Son adresse sert de user_param à l'événement qui termine la file
+
+// Cadence des redessins (voir ei_app_set_frame_rate)
+static double g_frame_interval = 0;        // En secondes, 0 : mode immédiat
+static double g_next_frame = 0;            // Date (hw_now) à partir de laquelle le prochain dessin est permis
+static void* g_frame_tick = NULL;          // Réveil programmé pour le prochain dessin, NULL si aucun
+static char g_frame_tick_marker;           // Son adresse sert de user_param au réveil
+
+// Dessin par tuiles avec un budget de temps (voir ei_app_set_redraw_budget)
+#define EI_REDRAW_TILE_SIZE 128
+static double g_redraw_budget = 0;         // En secondes, 0 : pas de budget
+static ei_live_resize_t g_live_resize = ei_live_resize_off;
+static int g_live_resize_relayout_ms = 100;
+// Qualité réduite pendant les manipulations (voir ei_app_set_interaction_quality)
+#define EI_INTERACTION_IDLE_MS 150          // Sans mouvement pendant ce délai, la pleine qualité revient
+static bool g_reduced_quality = true;
+static bool g_interacting = false;
+static ei_timer_t g_interaction_idle = NULL;
+static bool g_has_low_quality_area = false;
+static ei_rect_t g_low_quality_area;       // Englobe tout ce qui a été présenté en qualité réduite
+static bool g_motion_prediction = false;
+static double g_last_redraw = 0;           // Durée du dernier dessin, en secondes
+static double g_input_time = 0;            // Réception du plus ancien événement pas encore présenté, 0 si aucun
+static ei_point_t g_pointer;               // Dernière position connue de la souris
+static bool g_has_pointer = false;
+
+typedef struct redraw_tile_t {
+    ei_rect_t rect;
+    int       priority;                    // 0 : sous la souris, 1 : fenêtre au premier plan, 2 : le reste
+    int       index;                       // Ordre de découpage, départage les priorités égales
+} redraw_tile_t;
+
+static void add_invalidated_rect(const ei_rect_t* rect, bool merge_adjacent);
+
 
 
 // Fonction utilitaire pour fusionner deux rectangles
@@ -39,8 +94,15 @@ static ei_rect_t rect_union(const ei_rect_t* a, const ei_rect_t* b) {
 }
 
 void ei_app_create(ei_size_t main_window_size, bool fullscreen) {
+    ei_app_create_with_picking(main_window_size, fullscreen, ei_picking_offscreen);
+}
+
+void ei_app_create_with_picking(ei_size_t main_window_size, bool fullscreen, ei_picking_t picking) {
     // Initialiser le matériel
     hw_init();
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_input_time = 0;
+    g_last_redraw = 0;
 
     // Charger la police par défaut
     ei_default_font = hw_text_font_create(ei_default_font_filename, ei_style_normal, ei_font_default_size);
@@ -67,21 +129,18 @@ void ei_app_create(ei_size_t main_window_size, bool fullscreen) {
         main_window_size = hw_surface_get_size(g_root_surface);
     }
 
-    // Créer la surface de picking (forcer alpha pour faciliter la détection via canal alpha)
-    pick_surface = hw_surface_create(g_root_surface, main_window_size, true);
-    if (!pick_surface) {
-        fprintf(stderr, "Erreur: Impossible de créer la surface de picking.\n");
-        hw_surface_free(g_root_surface);
-        hw_text_font_free(ei_default_font);
-        hw_quit();
-        exit(1);
+    // Créer le buffer de picking (un pick_id sur 16 bits par pixel, voir ei_pick_buffer.h).
+    // En mode géométrique, pas de buffer : pick_surface reste NULL et les remplissages de picking sont ignorés.
+    pick_surface = NULL;
+    if (picking == ei_picking_offscreen) {
+        pick_surface = ei_impl_pick_buffer_create(main_window_size, 0xFFFF);
     }
 
     // Créer le widget racine (frame)
     g_root_widget = ei_widget_create("frame", NULL, NULL, NULL);
     if (!g_root_widget) {
         fprintf(stderr, "Erreur: Impossible de créer le widget racine.\n");
-        hw_surface_free(pick_surface);
+        ei_impl_pick_buffer_free(pick_surface);
         hw_surface_free(g_root_surface);
         hw_text_font_free(ei_default_font);
         hw_quit();
@@ -93,38 +152,252 @@ void ei_app_create(ei_size_t main_window_size, bool fullscreen) {
     g_root_widget->screen_location.size = main_window_size;
     g_root_widget->content_rect = &g_root_widget->screen_location; // Frame racine
     g_root_widget->requested_size = main_window_size;
+    ei_impl_widget_update_subtree_bounds(g_root_widget);
 
     // Invalider la zone initiale pour le premier dessin
     ei_app_invalidate_rect(&g_root_widget->screen_location);
 }
 
+// Copie les pixels de la source (de la taille de dst) vers dst, même si les deux zones se chevauchent.
+static void copy_rect(ei_surface_t surface, ei_point_t from, const ei_rect_t* dst) {
+    ei_size_t size = hw_surface_get_size(surface);
+    uint32_t* pixels = (uint32_t*)hw_surface_get_buffer(surface);
+    int height = dst->size.height;
+    bool downwards = dst->top_left.y > from.y;
+    for (int i = 0; i < height; i++) {
+        int row = downwards ? height - 1 - i : i;
+        memmove(pixels + (size_t)(dst->top_left.y + row) * size.width + dst->top_left.x,
+                pixels + (size_t)(from.y + row) * size.width + from.x,
+                dst->size.width * sizeof(uint32_t));
+    }
+}
+
+static void free_moves(void) {
+    while (g_moves_head != NULL) {
+        move_t* next = (move_t*)g_moves_head->link.next;
+        free(g_moves_head);
+        g_moves_head = next;
+    }
+    g_moves_tail = NULL;
+}
+
+static int compare_tiles(const void* a, const void* b) {
+    const redraw_tile_t* ta = a;
+    const redraw_tile_t* tb = b;
+    if (ta->priority != tb->priority) {
+        return ta->priority - tb->priority;
+    }
+    return ta->index - tb->index;
+}
+
+// Zone de la fenêtre au premier plan : l'enfant de la racine qui contient le widget actif, sinon le dernier.
+static bool focused_bounds(ei_rect_t* bounds) {
+    ei_widget_t widget = ei_event_get_active_widget();
+    while (widget != NULL && widget->parent != g_root_widget) {
+        widget = widget->parent;
+    }
+    if (widget == NULL) {
+        widget = g_root_widget->children_tail;
+    }
+    if (widget == NULL) {
+        return false;
+    }
+    *bounds = widget->subtree_bounds;
+    return true;
+}
+
+static void draw_root(const ei_rect_t* rect) {
+    if (!ei_impl_widget_cache_draw(g_root_widget, g_root_surface, rect)) {
+        g_root_widget->wclass->drawfunc(g_root_widget, g_root_surface, NULL, (ei_rect_t*)rect);
+    }
+}
+
+// Découpe les rectangles invalidés en tuiles, dessinées par priorité jusqu'à l'échéance (au moins une).
+// Les rectangles invalidés sont remplacés par les tuiles dessinées, les tuiles restantes sont retournées.
+static ei_linked_rect_t* draw_tiles_within_budget(double deadline) {
+    int nb_tiles = 0;
+    for (ei_linked_rect_t* rect = g_invalidated_rects_head; rect != NULL; rect = rect->next) {
+        int x_min = rect->rect.top_left.x / EI_REDRAW_TILE_SIZE;
+        int y_min = rect->rect.top_left.y / EI_REDRAW_TILE_SIZE;
+        int x_max = (rect->rect.top_left.x + rect->rect.size.width - 1) / EI_REDRAW_TILE_SIZE;
+        int y_max = (rect->rect.top_left.y + rect->rect.size.height - 1) / EI_REDRAW_TILE_SIZE;
+        nb_tiles += (x_max - x_min + 1) * (y_max - y_min + 1);
+    }
+    redraw_tile_t* tiles = malloc(nb_tiles * sizeof(redraw_tile_t));
+    if (tiles == NULL) {
+        for (ei_linked_rect_t* rect = g_invalidated_rects_head; rect != NULL; rect = rect->next) {
+            draw_root(&rect->rect);
+        }
+        return NULL;
+    }
+
+    ei_rect_t focus;
+    bool has_focus = focused_bounds(&focus);
+    int nb = 0;
+    for (ei_linked_rect_t* rect = g_invalidated_rects_head; rect != NULL; rect = rect->next) {
+        int x_min = rect->rect.top_left.x / EI_REDRAW_TILE_SIZE;
+        int y_min = rect->rect.top_left.y / EI_REDRAW_TILE_SIZE;
+        int x_max = (rect->rect.top_left.x + rect->rect.size.width - 1) / EI_REDRAW_TILE_SIZE;
+        int y_max = (rect->rect.top_left.y + rect->rect.size.height - 1) / EI_REDRAW_TILE_SIZE;
+        for (int y = y_min; y <= y_max; y++) {
+            for (int x = x_min; x <= x_max; x++) {
+                redraw_tile_t* tile = &tiles[nb];
+                ei_rect_t cell = ei_rect(ei_point(x * EI_REDRAW_TILE_SIZE, y * EI_REDRAW_TILE_SIZE),
+                                         ei_size(EI_REDRAW_TILE_SIZE, EI_REDRAW_TILE_SIZE));
+                ei_rect_t inter;
+                intersection_rect(&tile->rect, &cell, &rect->rect);
+                tile->index = nb++;
+                tile->priority = 2;
+                if (g_has_pointer && g_pointer.x >= tile->rect.top_left.x && g_pointer.y >= tile->rect.top_left.y &&
+                    g_pointer.x < tile->rect.top_left.x + tile->rect.size.width &&
+                    g_pointer.y < tile->rect.top_left.y + tile->rect.size.height) {
+                    tile->priority = 0;
+                } else if (has_focus && intersection_rect(&inter, &tile->rect, &focus)) {
+                    tile->priority = 1;
+                }
+            }
+        }
+    }
+    qsort(tiles, nb_tiles, sizeof(redraw_tile_t), compare_tiles);
+
+    ei_linked_rect_t* drawn = NULL;
+    ei_linked_rect_t* remainder = NULL;
+    for (int i = 0; i < nb_tiles; i++) {
+        ei_linked_rect_t* node = malloc(sizeof(ei_linked_rect_t));
+        if (node == NULL) {
+            // Pas de mémoire pour suivre la tuile : elle reste comprise dans la mise à jour complète
+            draw_root(&tiles[i].rect);
+            continue;
+        }
+        node->rect = tiles[i].rect;
+        if (i > 0 && hw_now() >= deadline) {
+            node->next = remainder;
+            remainder = node;
+        } else {
+            draw_root(&node->rect);
+            node->next = drawn;
+            drawn = node;
+        }
+    }
+    free(tiles);
+
+    ei_linked_rect_t* node = g_invalidated_rects_head;
+    while (node) {
+        ei_linked_rect_t* next = node->next;
+        free(node);
+        node = next;
+    }
+    g_invalidated_rects_head = drawn;
+    return remainder;
+}
+
 static void redraw_invalidated_areas(void) {
     if (!g_root_widget || !g_root_widget->wclass || !g_root_widget->wclass->drawfunc) {
         return;
     }
-    if (!g_invalidated_rects_head) {
+    if (!g_invalidated_rects_head && !g_repaints_head && !g_moves_head) {
         return;
     }
 
+    // Une repeinte partielle contenue dans un rectangle invalidé est inutile
+    repaint_t** link = &g_repaints_head;
+    while (*link != NULL) {
+        bool covered = false;
+        for (ei_linked_rect_t* rect = g_invalidated_rects_head; rect != NULL && !covered; rect = rect->next) {
+            ei_rect_t inter;
+            covered = intersection_rect(&inter, &(*link)->link.rect, &rect->rect) &&
+                      memcmp(&inter, &(*link)->link.rect, sizeof(ei_rect_t)) == 0;
+        }
+        if (covered) {
+            repaint_t* dead = *link;
+            *link = (repaint_t*)dead->link.next;
+            free(dead);
+        } else {
+            link = (repaint_t**)&(*link)->link.next;
+        }
+    }
+
+    double start = hw_now();
     hw_surface_lock(g_root_surface);
-    hw_surface_lock(pick_surface);
 
-    ei_color_t pick_clear_color = (ei_color_t){0, 0, 0, 0x00};
+    // Les déplacements d'abord : ils lisent l'écran tel qu'il était à la fin du dessin précédent
+    for (move_t* move = g_moves_head; move != NULL; move = (move_t*)move->link.next) {
+        copy_rect(g_root_surface, move->from, &move->link.rect);
+    }
 
-    // Dessiner chaque rectangle invalidé
-    ei_linked_rect_t* current = g_invalidated_rects_head;
-    while (current) {
-        // Réinitialiser uniquement la zone à redessiner pour conserver les couleurs des autres widgets.
-        ei_fill(pick_surface, &pick_clear_color, &current->rect);
-        g_root_widget->wclass->drawfunc(g_root_widget, g_root_surface, pick_surface, &current->rect);
-        current = current->next;
+    // Puis les repeintes partielles : si la géométrie a changé depuis leur demande, les
+    // rectangles invalidés (dessinés ensuite depuis la racine) corrigent les zones concernées.
+    for (repaint_t* repaint = g_repaints_head; repaint != NULL; repaint = (repaint_t*)repaint->link.next) {
+        repaint->start->wclass->drawfunc(repaint->start, g_root_surface, NULL, &repaint->link.rect);
     }
 
-    hw_surface_unlock(pick_surface);
+    // Dessiner chaque rectangle invalidé. Le buffer de picking n'est pas dessiné ici : les
+    // changements de géométrie y ont marqué leur zone en attente (voir ei_app_invalidate_rect).
+    // Avec un budget, seules les tuiles dessinées à temps sont présentées, les autres attendent.
+    ei_linked_rect_t* remainder = NULL;
+    if (g_redraw_budget > 0) {
+        remainder = draw_tiles_within_budget(start + g_redraw_budget);
+    } else {
+        for (ei_linked_rect_t* current = g_invalidated_rects_head; current != NULL; current = current->next) {
+            draw_root(&current->rect);
+        }
+    }
+
+    // Mettre à jour l'écran : destinations des déplacements, repeintes partielles, puis rectangles invalidés
+    ei_linked_rect_t* updated = g_invalidated_rects_head;
+    repaint_t* last_repaint = g_repaints_head;
+    if (last_repaint != NULL) {
+        while (last_repaint->link.next != NULL) {
+            last_repaint = (repaint_t*)last_repaint->link.next;
+        }
+        last_repaint->link.next = g_invalidated_rects_head;
+        updated = &g_repaints_head->link;
+    }
+    if (g_moves_tail != NULL) {
+        g_moves_tail->link.next = updated;
+        updated = &g_moves_head->link;
+    }
+
+    // Ce qui est présenté en qualité réduite sera redessiné à la fin de la manipulation
+    if (g_interacting) {
+        for (const ei_linked_rect_t* rect = updated; rect != NULL; rect = rect->next) {
+            g_low_quality_area = g_has_low_quality_area ? rect_union(&g_low_quality_area, &rect->rect) : rect->rect;
+            g_has_low_quality_area = true;
+        }
+    }
+
+    // Le filtre lit les pixels dessinés : il passe avant le déverrouillage
+    const ei_linked_rect_t* presented = updated;
+    if (ei_impl_present_filter_enabled()) {
+        presented = ei_impl_present_filter_run(g_root_surface, updated, &g_stats.present_bytes_saved);
+    }
     hw_surface_unlock(g_root_surface);
 
-    // Mettre à jour l'écran
-    hw_surface_update_rects(g_root_surface, g_invalidated_rects_head);
+    if (presented != NULL) {
+        for (const ei_linked_rect_t* rect = presented; rect != NULL; rect = rect->next) {
+            g_stats.presented_bytes += (uint64_t)rect->rect.size.width * rect->rect.size.height * sizeof(uint32_t);
+        }
+        hw_surface_update_rects(g_root_surface, presented);
+        if (g_input_time > 0) {
+            g_stats.input_latency_us += (uint64_t)((hw_now() - g_input_time) * 1e6);
+            g_stats.inputs_presented++;
+        }
+    }
+    g_input_time = 0;
+
+    // Libérer les déplacements et les repeintes partielles
+    if (g_moves_tail != NULL) {
+        g_moves_tail->link.next = NULL;
+    }
+    free_moves();
+    if (last_repaint != NULL) {
+        last_repaint->link.next = NULL;
+    }
+    while (g_repaints_head != NULL) {
+        repaint_t* next = (repaint_t*)g_repaints_head->link.next;
+        free(g_repaints_head);
+        g_repaints_head = next;
+    }
 
     // Libérer les rectangles invalidés
     ei_linked_rect_t* node = g_invalidated_rects_head;
@@ -134,6 +407,117 @@ static void redraw_invalidated_areas(void) {
         node = next;
     }
     g_invalidated_rects_head = NULL;
+
+    // Les tuiles non dessinées restent invalidées pour le prochain tour de boucle
+    if (remainder != NULL) {
+        g_stats.redraws_interrupted++;
+    }
+    while (remainder != NULL) {
+        ei_linked_rect_t* next = remainder->next;
+        add_invalidated_rect(&remainder->rect, false);
+        free(remainder);
+        remainder = next;
+    }
+}
+
+// Widget qui reçoit un événement : le widget actif, ou pour la souris le widget sous le pointeur.
+static ei_widget_t event_target(ei_event_t* event) {
+    ei_widget_t active_widget = ei_event_get_active_widget();
+    if (active_widget) {
+        return active_widget;
+    }
+    if (event->type >= ei_ev_mouse_buttondown && event->type <= ei_ev_mouse_wheel) {
+        return ei_widget_pick(&event->param.mouse.where);
+    }
+    return NULL;
+}
+
+static void dispatch_event(ei_event_t* event, ei_widget_t target_widget) {
+    if (g_application_quit_request) {
+        return;
+    }
+
+    // Cas spéciaux pour certains types d'événements
+    switch (event->type) {
+        case ei_ev_exposed:
+            // Invalider toute la fenêtre pour redessiner, l'écran ne montre plus ce qui a été présenté
+            ei_impl_present_filter_reset();
+            ei_app_invalidate_rect(&g_root_widget->screen_location);
+            return;
+        case ei_ev_close:
+            ei_app_quit_request();
+            return;
+        default:
+            break;
+    }
+
+    // Les placements demandés pendant le traitement sont faits ensemble à la fin (voir ei_layout_begin)
+    ei_layout_begin();
+
+    // Appeler le handlefunc du widget cible
+    bool event_handled = false;
+    if (target_widget && target_widget->wclass && target_widget->wclass->handlefunc) {
+        event_handled = target_widget->wclass->handlefunc(target_widget, event);
+    }
+
+    // Si non géré, appeler le gestionnaire par défaut
+    if (!event_handled) {
+        ei_default_handle_func_t default_handler = ei_event_get_default_handle_func();
+        if (default_handler) {
+            default_handler(event);
+        }
+    }
+    ei_layout_commit();
+}
+
+static bool is_drain_marker(const ei_event_t* event) {
+    return event->type == ei_ev_app && event->param.application.user_param == &g_drain_marker;
+}
+
+static bool is_frame_tick(const ei_event_t* event) {
+    return event->type == ei_ev_app && event->param.application.user_param == &g_frame_tick_marker;
+}
+
+static bool has_damage(void) {
+    return g_invalidated_rects_head != NULL || g_repaints_head != NULL || g_moves_head != NULL;
+}
+
+// Indique si le dessin peut avoir lieu maintenant. Sinon, programme un réveil à la date du prochain dessin.
+static bool frame_due(void) {
+    if (!has_damage()) {
+        return false;
+    }
+    if (g_frame_interval <= 0) {
+        return true;
+    }
+    double now = hw_now();
+    if (now >= g_next_frame) {
+        return true;
+    }
+    if (g_frame_tick == NULL) {
+        g_frame_tick = hw_event_schedule_app((int)((g_next_frame - now) * 1000) + 1, &g_frame_tick_marker);
+    }
+    return false;
+}
+
+static void cancel_frame_tick(void) {
+    if (g_frame_tick != NULL) {
+        hw_event_cancel_app(g_frame_tick);
+        g_frame_tick = NULL;
+    }
+}
+
+static void redraw_frame(void) {
+    double start = hw_now();
+    redraw_invalidated_areas();
+    g_stats.frames_presented++;
+    double end = hw_now();
+    g_last_redraw = end - start;
+    if (g_frame_interval > 0) {
+        // Un dessin plus long que l'intervalle retarde le suivant : le traitement des
+        // événements garde au moins un tiers du temps
+        g_next_frame = max(start + g_frame_interval, end + (end - start) / 2);
+    }
 }
 
 void ei_app_run(void) {
@@ -146,56 +530,79 @@ void ei_app_run(void) {
     ei_event_t event;
 
     while (!g_application_quit_request) {
-        // Redessiner les zones invalidées
-        redraw_invalidated_areas();
-
-        // Attendre le prochain événement
-        hw_event_wait_next(&event);
-
-        // Gérer l'événement
-        ei_widget_t target_widget = NULL;
-        bool event_handled = false;
-
-        // Cas spéciaux pour certains types d'événements
-        switch (event.type) {
-            case ei_ev_exposed:
-                // Invalider toute la fenêtre pour redessiner
-                ei_app_invalidate_rect(&g_root_widget->screen_location);
-                event_handled = true;
-                break;
-            case ei_ev_close:
-                ei_app_quit_request();
-                event_handled = true;
-                break;
-            default:
-                break;
+        // Redessiner les zones invalidées, à la cadence choisie
+        if (frame_due()) {
+            redraw_frame();
+            // Reste d'un dessin interrompu par son budget : il reprend après les événements en attente
+            if (has_damage() && g_frame_interval <= 0) {
+                hw_event_post_app(&g_frame_tick_marker);
+            } else if (has_damage()) {
+                frame_due();
+            }
         }
 
-        // Sélectionner le widget cible
-        if (!event_handled) {
+        // Attendre le prochain événement, puis traiter tous ceux déjà en attente avant de redessiner :
+        // le marqueur posté derrière eux signale la fin de la file.
+        hw_event_wait_next(&event);
+        hw_event_post_app(&g_drain_marker);
+
+        // Un déplacement de souris est retenu tant que le suivant est aussi un déplacement envoyé au
+        // même widget actif (ou sans widget actif) : seul le dernier d'une suite est traité, et donc
+        // seul lui demande un picking. Les autres événements gardent leur ordre.
+        ei_event_t held_move;
+        ei_widget_t held_active = NULL;
+        bool holding = false;
+        while (!is_drain_marker(&event)) {
+            if (is_frame_tick(&event)) {
+                // Le réveil n'est pas transmis à l'application : il fait seulement repasser par le dessin
+                g_frame_tick = NULL;
+                hw_event_wait_next(&event);
+                continue;
+            }
+            if (ei_impl_timer_is_tick(&event)) {
+                ei_layout_begin();
+                ei_impl_timer_run();
+                ei_layout_commit();
+                hw_event_wait_next(&event);
+                continue;
+            }
+            if (event.type >= ei_ev_mouse_buttondown && event.type <= ei_ev_mouse_wheel) {
+                g_pointer = event.param.mouse.where;
+                g_has_pointer = true;
+            }
+            if (event.type != ei_ev_app && g_input_time == 0) {
+                g_input_time = hw_now();
+            }
             ei_widget_t active_widget = ei_event_get_active_widget();
-            if (active_widget) {
-                target_widget = active_widget;
-            } else if (event.type >= ei_ev_mouse_buttondown && event.type <= ei_ev_mouse_wheel) {
-                target_widget = ei_widget_pick(&event.param.mouse.where);
-            } else if (event.type == ei_ev_keydown || event.type == ei_ev_keyup || event.type == ei_ev_text_input) {
-                target_widget = ei_event_get_active_widget(); // Utiliser le widget actif pour le clavier
+            if (holding && event.type == ei_ev_mouse_move && active_widget == held_active) {
+                g_stats.mouse_moves_dropped++;
+                held_move = event;
+                hw_event_wait_next(&event);
+                continue;
             }
-
-            // Appeler le handlefunc du widget cible
-            if (target_widget && target_widget->wclass && target_widget->wclass->handlefunc) {
-                event_handled = target_widget->wclass->handlefunc(target_widget, &event);
+            if (holding) {
+                // Le traitement peut changer le widget actif ou la géométrie : cible de l'événement suivant choisie après
+                dispatch_event(&held_move, event_target(&held_move));
+                holding = false;
             }
-
-            // Si non géré, appeler le gestionnaire par défaut
-            if (!event_handled) {
-                ei_default_handle_func_t default_handler = ei_event_get_default_handle_func();
-                if (default_handler) {
-                    default_handler(&event);
-                }
+            if (event.type == ei_ev_mouse_move) {
+                holding = true;
+                held_move = event;
+                held_active = ei_event_get_active_widget();
+            } else {
+                dispatch_event(&event, event_target(&event));
             }
+            hw_event_wait_next(&event);
+        }
+        if (holding) {
+            dispatch_event(&held_move, event_target(&held_move));
+        }
+        // Des événements sans effet à l'écran ne sont pas comptés dans la latence du dessin suivant
+        if (!has_damage()) {
+            g_input_time = 0;
         }
     }
+    cancel_frame_tick();
 }
 
 void ei_app_free(void) {
@@ -207,6 +614,7 @@ void ei_app_free(void) {
         current = next;
     }
     g_invalidated_rects_head = NULL;
+    free_moves();
 
     // Détruire le widget racine et ses enfants
     if (g_root_widget) {
@@ -214,9 +622,18 @@ void ei_app_free(void) {
         g_root_widget = NULL;
     }
 
+    ei_impl_timer_release();
+    g_interaction_idle = NULL;
+    g_interacting = false;
+    g_has_low_quality_area = false;
+    ei_impl_text_cache_clear();
+    ei_impl_layout_release();
+
     // Libérer les surfaces
+    ei_impl_widget_cache_release();
+    ei_impl_present_filter_release();
     if (pick_surface) {
-        hw_surface_free(pick_surface);
+        ei_impl_pick_buffer_free(pick_surface);
         pick_surface = NULL;
     }
     if (g_root_surface) {
@@ -243,6 +660,29 @@ void ei_app_invalidate_rect(const ei_rect_t* rect) {
         return;
     }
 
+    // Changement de géométrie ou d'empilement : les pick_id de la zone changent aussi
+    if (pick_surface) {
+        ei_impl_pick_buffer_invalidate(pick_surface, rect);
+    }
+    ei_impl_app_invalidate_paint(rect);
+}
+
+void ei_impl_app_invalidate_paint(const ei_rect_t* rect) {
+    add_invalidated_rect(rect, true);
+}
+
+void ei_impl_app_invalidate_pick(const ei_rect_t* rect) {
+    if (pick_surface && rect && rect->size.width > 0 && rect->size.height > 0) {
+        ei_impl_pick_buffer_invalidate(pick_surface, rect);
+    }
+}
+
+// Ajoute un rectangle à redessiner, fusionné avec ceux qu'il chevauche (ou touche, si merge_adjacent).
+static void add_invalidated_rect(const ei_rect_t* rect, bool merge_adjacent) {
+    if (!rect || rect->size.width <= 0 || rect->size.height <= 0) {
+        return;
+    }
+
     if (g_root_surface == NULL) {
         return;
     }
@@ -264,7 +704,7 @@ void ei_app_invalidate_rect(const ei_rect_t* rect) {
         int dy = max(current->rect.top_left.y, clipped_rect.top_left.y) -
                  min(current->rect.top_left.y + current->rect.size.height,
                      clipped_rect.top_left.y + clipped_rect.size.height);
-        if (dx <= 0 && dy <= 0) {
+        if (merge_adjacent ? (dx <= 0 && dy <= 0) : (dx < 0 && dy < 0)) {
             // Fusionner les rectangles
             current->rect = rect_union(&current->rect, &clipped_rect);
             return;
@@ -295,3 +735,200 @@ ei_widget_t ei_app_root_widget(void) {
 ei_surface_t ei_app_root_surface(void) {
     return g_root_surface;
 }
+
+void ei_app_set_present_filter(bool enabled) {
+    ei_impl_present_filter_enable(enabled);
+}
+
+void ei_app_set_frame_rate(double frame_rate) {
+    g_frame_interval = frame_rate > 0 ? 1.0 / frame_rate : 0;
+    g_next_frame = 0;
+    cancel_frame_tick();
+}
+
+void ei_app_set_redraw_budget(double seconds) {
+    g_redraw_budget = seconds > 0 ? seconds : 0;
+}
+
+void ei_app_set_live_resize(ei_live_resize_t mode, int relayout_ms) {
+    g_live_resize = mode;
+    g_live_resize_relayout_ms = relayout_ms > 0 ? relayout_ms : 0;
+}
+
+void ei_app_set_interaction_quality(bool reduced) {
+    g_reduced_quality = reduced;
+    if (!reduced) {
+        ei_impl_app_end_interaction();
+    }
+}
+
+static void interaction_idle_cb(ei_timer_t timer, ei_user_param_t user_param) {
+    (void)timer;
+    (void)user_param;
+    g_interaction_idle = NULL;
+    ei_impl_app_end_interaction();
+}
+
+void ei_app_set_motion_prediction(bool enabled) {
+    g_motion_prediction = enabled;
+}
+
+bool ei_impl_app_motion_prediction(void) {
+    return g_motion_prediction;
+}
+
+double ei_impl_app_expected_present(void) {
+    double now = hw_now();
+    double start = g_frame_interval > 0 && g_next_frame > now ? g_next_frame : now;
+    return start + g_last_redraw;
+}
+
+void ei_impl_app_note_drag_lag(double distance) {
+    g_stats.drag_lag_px += (uint64_t)(distance + 0.5);
+    g_stats.drag_samples++;
+}
+
+void ei_impl_app_begin_interaction(void) {
+    if (!g_reduced_quality) {
+        return;
+    }
+    g_interacting = true;
+    if (g_interaction_idle != NULL) {
+        ei_timer_cancel(g_interaction_idle);
+    }
+    g_interaction_idle = ei_timer_start(EI_INTERACTION_IDLE_MS, 0, NULL, interaction_idle_cb, NULL);
+}
+
+void ei_impl_app_end_interaction(void) {
+    if (g_interaction_idle != NULL) {
+        ei_timer_cancel(g_interaction_idle);
+        g_interaction_idle = NULL;
+    }
+    g_interacting = false;
+    ei_impl_text_cache_clear();
+    if (g_has_low_quality_area) {
+        g_has_low_quality_area = false;
+        ei_impl_app_invalidate_paint(&g_low_quality_area);
+    }
+}
+
+bool ei_impl_app_low_quality(void) {
+    return g_interacting;
+}
+
+ei_live_resize_t ei_impl_app_live_resize(int* relayout_ms) {
+    if (relayout_ms != NULL) {
+        *relayout_ms = g_live_resize_relayout_ms;
+    }
+    return g_live_resize;
+}
+
+void ei_app_get_stats(ei_app_stats_t* stats) {
+    *stats = g_stats;
+}
+
+void ei_impl_app_queue_repaint(ei_widget_t start, const ei_rect_t* rect) {
+    // Déjà demandée par une repeinte partant du même widget ?
+    for (repaint_t* repaint = g_repaints_head; repaint != NULL; repaint = (repaint_t*)repaint->link.next) {
+        ei_rect_t inter;
+        if (repaint->start == start && intersection_rect(&inter, &repaint->link.rect, rect) &&
+            memcmp(&inter, rect, sizeof(ei_rect_t)) == 0) {
+            return;
+        }
+    }
+    repaint_t* repaint = malloc(sizeof(repaint_t));
+    if (!repaint) {
+        // Pas de mémoire : on se rabat sur une invalidation classique
+        ei_impl_app_invalidate_paint(rect);
+        return;
+    }
+    repaint->start = start;
+    repaint->link.rect = *rect;
+    repaint->link.next = (ei_linked_rect_t*)g_repaints_head;
+    g_repaints_head = repaint;
+}
+
+static bool rect_is_inside(const ei_rect_t* inner, const ei_rect_t* outer) {
+    ei_rect_t inter;
+    return intersection_rect(&inter, inner, outer) && memcmp(&inter, inner, sizeof(ei_rect_t)) == 0;
+}
+
+bool ei_impl_app_move_rect(const ei_rect_t* from, ei_point_t to) {
+    if (g_root_surface == NULL || from->size.width <= 0 || from->size.height <= 0) {
+        return false;
+    }
+    ei_rect_t to_rect = ei_rect(to, from->size);
+    ei_rect_t surface_rect = ei_rect(ei_point_zero(), hw_surface_get_size(g_root_surface));
+    if (!rect_is_inside(from, &surface_rect) || !rect_is_inside(&to_rect, &surface_rect)) {
+        return false;
+    }
+
+    // La source doit être à jour à l'écran au moment de la copie
+    ei_rect_t inter;
+    for (ei_linked_rect_t* rect = g_invalidated_rects_head; rect != NULL; rect = rect->next) {
+        if (intersection_rect(&inter, &rect->rect, from)) {
+            return false;
+        }
+    }
+    for (repaint_t* repaint = g_repaints_head; repaint != NULL; repaint = (repaint_t*)repaint->link.next) {
+        if (intersection_rect(&inter, &repaint->link.rect, from) ||
+            intersection_rect(&inter, &repaint->link.rect, &to_rect)) {
+            return false;
+        }
+    }
+    // Seul un déplacement précédent du même contenu (vers exactement "from") peut écrire dans la source
+    for (move_t* move = g_moves_head; move != NULL; move = (move_t*)move->link.next) {
+        if (intersection_rect(&inter, &move->link.rect, from) &&
+            memcmp(&move->link.rect, from, sizeof(ei_rect_t)) != 0) {
+            return false;
+        }
+    }
+
+    move_t* move = malloc(sizeof(move_t));
+    if (move == NULL) {
+        return false;
+    }
+    move->link.rect = to_rect;
+    move->link.next = NULL;
+    move->from = from->top_left;
+    if (g_moves_tail != NULL) {
+        g_moves_tail->link.next = &move->link;
+    } else {
+        g_moves_head = move;
+    }
+    g_moves_tail = move;
+
+    if (pick_surface) {
+        ei_impl_pick_buffer_invalidate(pick_surface, from);
+        ei_impl_pick_buffer_invalidate(pick_surface, &to_rect);
+    }
+
+    // Redessiner la partie de l'ancienne zone que la copie ne recouvre pas (au plus 4 bandes)
+    ei_rect_t strips[4];
+    int nb_strips = subtract_rect(strips, from, &to_rect);
+    ei_impl_app_invalidate_region(strips, nb_strips, false);
+    return true;
+}
+
+void ei_impl_app_invalidate_region(const ei_rect_t* rects, int nb_rects, bool geometry) {
+    for (int i = 0; i < nb_rects; i++) {
+        if (geometry && pick_surface) {
+            ei_impl_pick_buffer_invalidate(pick_surface, &rects[i]);
+        }
+        // Les rectangles se touchent : les fusionner redessinerait aussi ce qui les sépare
+        add_invalidated_rect(&rects[i], false);
+    }
+}
+
+void ei_impl_app_cancel_repaints(ei_widget_t widget) {
+    repaint_t** link = &g_repaints_head;
+    while (*link != NULL) {
+        if ((*link)->start == widget) {
+            repaint_t* dead = *link;
+            *link = (repaint_t*)dead->link.next;
+            free(dead);
+        } else {
+            link = (repaint_t**)&(*link)->link.next;
+        }
+    }
+}
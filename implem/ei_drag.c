@@ -0,0 +1,66 @@
+#include "ei_drag.h"
+#include "ei_implementation.h"
+#include "hw_interface.h"
+#include "ei_utils.h"
+#include <math.h>
+
+#define EI_DRAG_SMOOTHING   0.5f    // Poids de la dernière mesure dans l'estimation de la vitesse
+#define EI_DRAG_STILL       0.1     // Au-delà de ce délai sans mouvement (s), le pointeur est considéré arrêté
+#define EI_DRAG_MAX_LEAD    0.05    // Extrapolation maximale (s), pour borner l'erreur d'une prédiction
+
+
+void ei_drag_begin(ei_drag_t* drag, ei_point_t pointer, ei_point_t origin) {
+    drag->origin = origin;
+    drag->start = pointer;
+    drag->pointer = pointer;
+    drag->time = hw_now();
+    drag->velocity_x = 0;
+    drag->velocity_y = 0;
+    drag->drawn = origin;
+    drag->present_time = drag->time;
+    drag->active = true;
+}
+
+ei_point_t ei_drag_position(const ei_drag_t* drag) {
+    return ei_point(drag->origin.x + drag->pointer.x - drag->start.x,
+                    drag->origin.y + drag->pointer.y - drag->start.y);
+}
+
+ei_point_t ei_drag_update(ei_drag_t* drag, ei_point_t pointer) {
+    double now = hw_now();
+    double dt = now - drag->time;
+    if (dt > EI_DRAG_STILL) {
+        drag->velocity_x = 0;
+        drag->velocity_y = 0;
+    } else if (dt > 0) {
+        float vx = (float)((pointer.x - drag->pointer.x) / dt);
+        float vy = (float)((pointer.y - drag->pointer.y) / dt);
+        drag->velocity_x += EI_DRAG_SMOOTHING * (vx - drag->velocity_x);
+        drag->velocity_y += EI_DRAG_SMOOTHING * (vy - drag->velocity_y);
+    }
+    drag->pointer = pointer;
+    drag->time = now;
+
+    // Écart entre la position dessinée précédente, maintenant à l'écran, et celle du pointeur.
+    // Une position remplacée avant sa présentation n'a jamais été vue : pas de mesure.
+    ei_point_t exact = ei_drag_position(drag);
+    if (now >= drag->present_time) {
+        ei_impl_app_note_drag_lag(hypot(exact.x - drag->drawn.x, exact.y - drag->drawn.y));
+    }
+
+    drag->drawn = exact;
+    drag->present_time = ei_impl_app_expected_present();
+    if (ei_impl_app_motion_prediction()) {
+        double lead = drag->present_time - now;
+        lead = lead < 0 ? 0 : (lead > EI_DRAG_MAX_LEAD ? EI_DRAG_MAX_LEAD : lead);
+        drag->drawn.x += (int)lroundf(drag->velocity_x * (float)lead);
+        drag->drawn.y += (int)lroundf(drag->velocity_y * (float)lead);
+    }
+    return drag->drawn;
+}
+
+ei_point_t ei_drag_end(ei_drag_t* drag) {
+    drag->active = false;
+    drag->drawn = ei_drag_position(drag);
+    return drag->drawn;
+}
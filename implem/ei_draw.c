@@ -1,13 +1,46 @@
 #include "ei_draw.h"
 #include "hw_interface.h"
 #include "ei_implementation.h"
+#include "ei_pick_buffer.h"
 #include "ei_utils.h"
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
+#define EI_TEXT_CACHE_SIZE 32   // Rendus de texte gardés pendant une manipulation
+
+// Rendu d'un texte, gardé tant que la qualité est réduite (voir ei_impl_app_low_quality).
+typedef struct {
+    char*           text;       // NULL si l'entrée est libre
+    ei_font_t       font;
+    ei_color_t      color;
+    ei_surface_t    surface;
+    unsigned        stamp;      // Date du dernier usage, pour évincer le plus ancien
+} text_cache_entry_t;
+
+static text_cache_entry_t   g_text_cache[EI_TEXT_CACHE_SIZE];
+static unsigned             g_text_cache_clock = 0;
+
+// Rien à dessiner sur une surface NULL. Le buffer de picking n'est pas une surface hw : ei_fill et
+// les polygones / polylignes y écrivent le pick_id codé par la couleur, le texte et les copies l'ignorent.
+static inline bool not_drawable(ei_surface_t surface) {
+    return surface == NULL || surface == pick_surface;
+}
+
 // Cette fonction remplit une zone avec une couleur (comme si on peignait un mur !)
 void ei_fill(ei_surface_t surface, const ei_color_t* couleur, const ei_rect_t* clipper)
 {
+    // Pas de surface de picking en mode géométrique : les widgets y remplissent quand même leur couleur
+    if (surface == NULL) {
+        return;
+    }
+    // Le buffer de picking n'est pas une surface hw : on y écrit directement le pick_id
+    if (surface == pick_surface) {
+        ei_impl_pick_buffer_fill(pick_surface, ei_impl_pick_id_from_color(couleur), clipper);
+        return;
+    }
+
     // On récupère le buffer (l'endroit où on dessine) et la taille de la surface
     uint8_t* pixel_0 = hw_surface_get_buffer(surface);
     ei_size_t taille_surface = hw_surface_get_size(surface);
@@ -54,7 +87,7 @@ void ei_draw_polyline(ei_surface_t surface, ei_point_t* points, size_t taille_po
                       ei_color_t couleur, const ei_rect_t* clipper)
 {
     // S’il n’y a pas de points, on fait rien
-    if (taille_points == 0) return;
+    if (taille_points == 0 || surface == NULL) return;
 
     // Juste un point ? On dessine un point (une ligne qui va nulle part)
     if (taille_points == 1) {
@@ -72,10 +105,11 @@ void ei_draw_polygon(ei_surface_t surface, ei_point_t* points, size_t taille_poi
                      ei_color_t couleur, const ei_rect_t* clipper)
 {
     // S’il n’y a pas assez de points ou c’est vide, on dégage
-    if (points == NULL || taille_points < 3) return;
+    if (points == NULL || taille_points < 3 || surface == NULL) return;
 
     // On récupère la taille de l’écran
-    ei_size_t taille_surface = hw_surface_get_size(surface);
+    ei_size_t taille_surface = surface == pick_surface ? ei_impl_pick_buffer_size(pick_surface)
+                                                       : hw_surface_get_size(surface);
 
     // On cherche les y minimum et maximum du polygone
     int y_min = points[0].y;
@@ -172,6 +206,80 @@ void ei_draw_polygon(ei_surface_t surface, ei_point_t* points, size_t taille_poi
 }
 
 
+void ei_impl_text_cache_clear(void) {
+    for (int i = 0; i < EI_TEXT_CACHE_SIZE; i++) {
+        if (g_text_cache[i].text != NULL) {
+            free(g_text_cache[i].text);
+            hw_surface_free(g_text_cache[i].surface);
+            g_text_cache[i].text = NULL;
+        }
+    }
+}
+
+// Retourne le rendu gardé du texte, en le créant si besoin. La surface appartient au cache.
+static ei_surface_t cached_text_surface(ei_const_string_t text, ei_font_t font, ei_color_t color) {
+    text_cache_entry_t* victim = &g_text_cache[0];
+    for (int i = 0; i < EI_TEXT_CACHE_SIZE; i++) {
+        text_cache_entry_t* entry = &g_text_cache[i];
+        if (entry->text != NULL && entry->font == font && strcmp(entry->text, text) == 0 &&
+            memcmp(&entry->color, &color, sizeof(ei_color_t)) == 0) {
+            entry->stamp = ++g_text_cache_clock;
+            return entry->surface;
+        }
+        if (victim->text != NULL && (entry->text == NULL || entry->stamp < victim->stamp)) {
+            victim = entry;
+        }
+    }
+
+    ei_surface_t text_surface = hw_text_create_surface(text, font, color);
+    char* copy = strdup(text);
+    if (text_surface == NULL || copy == NULL) {
+        if (text_surface != NULL) {
+            hw_surface_free(text_surface);
+        }
+        free(copy);
+        return NULL;
+    }
+    if (victim->text != NULL) {
+        free(victim->text);
+        hw_surface_free(victim->surface);
+    }
+    *victim = (text_cache_entry_t){copy, font, color, text_surface, ++g_text_cache_clock};
+    return text_surface;
+}
+
+// Copie un rendu de texte sans mélange : un pixel prend la couleur du texte s'il est opaque
+// à plus de moitié, il est laissé tel quel sinon.
+static void copy_text_thresholded(ei_surface_t surface, const ei_rect_t* dst_rect,
+                                  ei_surface_t text_surface, ei_point_t src, ei_color_t color) {
+    ei_size_t dst_size = hw_surface_get_size(surface);
+    ei_size_t src_size = hw_surface_get_size(text_surface);
+    ei_rect_t area;
+    ei_rect_t surface_rect = ei_rect(ei_point_zero(), dst_size);
+    if (!intersection_rect(&area, dst_rect, &surface_rect)) {
+        return;
+    }
+    src.x += area.top_left.x - dst_rect->top_left.x;
+    src.y += area.top_left.y - dst_rect->top_left.y;
+
+    hw_surface_lock(text_surface);
+    uint32_t* dst_buffer = (uint32_t*)hw_surface_get_buffer(surface);
+    uint8_t* src_buffer = hw_surface_get_buffer(text_surface);
+    int src_ir, src_ig, src_ib, src_ia;
+    hw_surface_get_channel_indices(text_surface, &src_ir, &src_ig, &src_ib, &src_ia);
+    uint32_t pixel = ei_impl_map_rgba(surface, color);
+    for (int y = 0; y < area.size.height; y++) {
+        uint32_t* dst_row = dst_buffer + (size_t)(area.top_left.y + y) * dst_size.width + area.top_left.x;
+        uint8_t* src_row = src_buffer + ((size_t)(src.y + y) * src_size.width + src.x) * 4;
+        for (int x = 0; x < area.size.width; x++) {
+            if (src_ia < 0 || src_row[x * 4 + src_ia] >= 0x80) {
+                dst_row[x] = pixel;
+            }
+        }
+    }
+    hw_surface_unlock(text_surface);
+}
+
 void ei_draw_text(ei_surface_t surface,
                   const ei_point_t* where,
                   ei_const_string_t text,
@@ -179,10 +287,12 @@ void ei_draw_text(ei_surface_t surface,
                   ei_color_t color,
                   const ei_rect_t* clipper) {
     // Validate inputs
-    assert(surface != NULL && "Surface cannot be NULL");
     assert(where != NULL && "Position cannot be NULL");
     assert(text != NULL && "Text cannot be NULL");
     assert(color.red != 255 || color.green != 255 || color.blue != 255 || "Color cannot be NULL");
+    if (not_drawable(surface)) {
+        return;
+    }
 
     // Use default font if none provided
     ei_font_t font_used = font ? font : ei_default_font;
@@ -193,8 +303,12 @@ void ei_draw_text(ei_surface_t surface,
     // Ignore alpha channel in color
     ei_color_t text_color = {color.red, color.green, color.blue, 255};
 
+    // En qualité réduite : le rendu gardé, copié sans mélange
+    bool low_quality = ei_impl_app_low_quality();
+
     // Create text surface
-    ei_surface_t text_surface = hw_text_create_surface(text, font_used, text_color);
+    ei_surface_t text_surface = low_quality ? cached_text_surface(text, font_used, text_color)
+                                            : hw_text_create_surface(text, font_used, text_color);
     if (text_surface == NULL) {
         return; // Failed to create text surface
     }
@@ -202,7 +316,9 @@ void ei_draw_text(ei_surface_t surface,
     // Get text surface size
     ei_size_t text_size = hw_surface_get_size(text_surface);
     if (text_size.width <= 0 || text_size.height <= 0) {
-        hw_surface_free(text_surface);
+        if (!low_quality) {
+            hw_surface_free(text_surface);
+        }
         return; // Empty text surface
     }
 
@@ -213,7 +329,9 @@ void ei_draw_text(ei_surface_t surface,
     ei_rect_t clipped_dst_rect = dst_rect;
     if (clipper != NULL) {
         if (!intersection_rect(&clipped_dst_rect, &dst_rect, clipper)) {
-            hw_surface_free(text_surface);
+            if (!low_quality) {
+                hw_surface_free(text_surface);
+            }
             return; // No overlap with clipper
         }
     }
@@ -223,6 +341,11 @@ void ei_draw_text(ei_surface_t surface,
     src_rect.top_left.x = clipped_dst_rect.top_left.x - dst_rect.top_left.x;
     src_rect.top_left.y = clipped_dst_rect.top_left.y - dst_rect.top_left.y;
 
+    if (low_quality) {
+        copy_text_thresholded(surface, &clipped_dst_rect, text_surface, src_rect.top_left, text_color);
+        return;
+    }
+
     // Copy text surface to destination
     ei_copy_surface(surface, &clipped_dst_rect, text_surface, &src_rect, true);
 
@@ -237,7 +360,7 @@ int ei_copy_surface(ei_surface_t destination,
                     const ei_rect_t* src_rect,
                     bool alpha) {
     // Validate inputs
-    if (destination == NULL || source == NULL) {
+    if (not_drawable(destination) || not_drawable(source)) {
         return 1;
     }
 
@@ -1,19 +1,28 @@
 #include "ei_implementation.h"
 #include "hw_interface.h"
 #include <stdlib.h>
+#include <string.h>
 #include "ei_widget_attributes.h"
+#include "ei_utils.h"
+#include "ei_spatial_index.h"
+#include "ei_pick_buffer.h"
+#include "ei_widget_cache.h"
 #include "assert.h"
 
 // Dessine une ligne entre deux points avec l'algo de Bresenham (ça fait des lignes bien droites !)
 void draw_line(ei_surface_t surface, ei_point_t point_1, ei_point_t point_2, ei_color_t couleur, const ei_rect_t* clipper)
 {
+    // Dans le buffer de picking, chaque pixel reçoit le pick_id codé par la couleur
+    bool pick = surface == pick_surface;
+    uint32_t pick_id = ei_impl_pick_id_from_color(&couleur);
+
     // On récupère le buffer (l'endroit où on dessine) et la taille de la surface
-    uint8_t* pixel_0 = hw_surface_get_buffer(surface);
-    ei_size_t taille_surface = hw_surface_get_size(surface);
+    uint8_t* pixel_0 = pick ? NULL : hw_surface_get_buffer(surface);
+    ei_size_t taille_surface = pick ? ei_impl_pick_buffer_size(pick_surface) : hw_surface_get_size(surface);
 
     // On convertit la couleur en un format que la surface comprend (ça dépend si t'es sur Mac, Windows ou Linux)
     #if defined(_APPLE_) || defined(_WIN32)
-        uint32_t valeur_pixel = ei_impl_map_rgba(surface, couleur);
+        uint32_t valeur_pixel = pick ? 0 : ei_impl_map_rgba(surface, couleur);
     #else
         uint32_t valeur_pixel = *((uint32_t*)&couleur);
     #endif
@@ -57,9 +66,13 @@ void draw_line(ei_surface_t surface, ei_point_t point_1, ei_point_t point_2, ei_
         // On dessine seulement si le pixel est dans la zone autorisée
         if (x >= 0 && x < taille_surface.width && y >= 0 && y < taille_surface.height &&
                     x >= clip_xmin && x <= clip_xmax && y >= clip_ymin && y <= clip_ymax) {
-            // Calculer la position du pixel de manière sûre
-            uint32_t* pixel_ptr = (uint32_t*)(pixel_0 + (y * taille_surface.width + x) * 4);
-            *pixel_ptr = valeur_pixel;
+            if (pick) {
+                ei_impl_pick_buffer_fill(pick_surface, pick_id, &(ei_rect_t){{x, y}, {1, 1}});
+            } else {
+                // Calculer la position du pixel de manière sûre
+                uint32_t* pixel_ptr = (uint32_t*)(pixel_0 + (y * taille_surface.width + x) * 4);
+                *pixel_ptr = valeur_pixel;
+            }
         }
 
         // Si on est arrivé au point final, on arrête
@@ -98,6 +111,15 @@ void draw_horizontal_line(ei_surface_t surface, int x1, int x2, int y, ei_color_
         x2 = a;
     }
 
+    // Dans le buffer de picking, le segment reçoit le pick_id codé par la couleur
+    if (surface == pick_surface) {
+        ei_rect_t segment = {{x1, y}, {x2 - x1 + 1, 1}};
+        if (clipper == NULL || intersection_rect(&segment, &segment, clipper)) {
+            ei_impl_pick_buffer_fill(pick_surface, ei_impl_pick_id_from_color(&couleur), &segment);
+        }
+        return;
+    }
+
     // On récupère le buffer et la taille de la surface
     uint8_t* pixel_0 = hw_surface_get_buffer(surface);
     ei_size_t taille_surface = hw_surface_get_size(surface);
@@ -306,6 +328,31 @@ bool intersection_rect(ei_rect_t* dest, const ei_rect_t* a, const ei_rect_t* b)
     return false;
 }
 
+void union_rect(ei_rect_t* dest, const ei_rect_t* a, const ei_rect_t* b) {
+    assert(dest != NULL && a != NULL && b != NULL);
+
+    if (a->size.width <= 0 || a->size.height <= 0) {
+        *dest = *b;
+        return;
+    }
+    if (b->size.width <= 0 || b->size.height <= 0) {
+        *dest = *a;
+        return;
+    }
+
+    int x1 = a->top_left.x < b->top_left.x ? a->top_left.x : b->top_left.x;
+    int y1 = a->top_left.y < b->top_left.y ? a->top_left.y : b->top_left.y;
+    int x2 = (a->top_left.x + a->size.width) > (b->top_left.x + b->size.width) ?
+             (a->top_left.x + a->size.width) : (b->top_left.x + b->size.width);
+    int y2 = (a->top_left.y + a->size.height) > (b->top_left.y + b->size.height) ?
+             (a->top_left.y + a->size.height) : (b->top_left.y + b->size.height);
+
+    dest->top_left.x = x1;
+    dest->top_left.y = y1;
+    dest->size.width = x2 - x1;
+    dest->size.height = y2 - y1;
+}
+
 void clamp_rect_to_surface(ei_rect_t* rect, ei_surface_t surface) {
     assert(rect != NULL && surface != NULL);
     
@@ -335,45 +382,337 @@ void clamp_rect_to_surface(ei_rect_t* rect, ei_surface_t surface) {
 }
 
 
+int subtract_rect(ei_rect_t dest[4], const ei_rect_t* a, const ei_rect_t* b) {
+    assert(dest != NULL && a != NULL && b != NULL);
+
+    ei_rect_t inter;
+    if (!intersection_rect(&inter, a, b)) {
+        dest[0] = *a;
+        return 1;
+    }
+
+    int count = 0;
+    int a_right = a->top_left.x + a->size.width;
+    int a_bottom = a->top_left.y + a->size.height;
+    int i_right = inter.top_left.x + inter.size.width;
+    int i_bottom = inter.top_left.y + inter.size.height;
+
+    // Bande du haut et du bas sur toute la largeur de a
+    if (inter.top_left.y > a->top_left.y) {
+        dest[count++] = ei_rect(a->top_left, ei_size(a->size.width, inter.top_left.y - a->top_left.y));
+    }
+    if (i_bottom < a_bottom) {
+        dest[count++] = ei_rect(ei_point(a->top_left.x, i_bottom), ei_size(a->size.width, a_bottom - i_bottom));
+    }
+    // Bandes gauche et droite à la hauteur de l'intersection
+    if (inter.top_left.x > a->top_left.x) {
+        dest[count++] = ei_rect(ei_point(a->top_left.x, inter.top_left.y), ei_size(inter.top_left.x - a->top_left.x, inter.size.height));
+    }
+    if (i_right < a_right) {
+        dest[count++] = ei_rect(ei_point(i_right, inter.top_left.y), ei_size(a_right - i_right, inter.size.height));
+    }
+    return count;
+}
+
+int ei_impl_widget_invariance(ei_widget_t widget) {
+    assert(widget != NULL);
+    if (widget->wclass_ext == NULL || widget->wclass_ext->invariancefunc == NULL) {
+        return ei_impl_invariant_none;
+    }
+    return widget->wclass_ext->invariancefunc(widget);
+}
+
+bool ei_impl_widget_opaque_rect(ei_widget_t widget, ei_rect_t* opaque_rect) {
+    assert(widget != NULL && opaque_rect != NULL);
+
+    if (widget->wclass_ext == NULL || widget->wclass_ext->opaquefunc == NULL) {
+        return false;
+    }
+    if (!widget->wclass_ext->opaquefunc(widget, opaque_rect)) {
+        return false;
+    }
+    return opaque_rect->size.width > 0 && opaque_rect->size.height > 0;
+}
+
+
+// Vrai si rect est vide ou entièrement contenu dans container.
+static bool rect_inside(const ei_rect_t* rect, const ei_rect_t* container) {
+    if (rect->size.width <= 0 || rect->size.height <= 0) {
+        return true;
+    }
+    return rect->top_left.x >= container->top_left.x &&
+           rect->top_left.y >= container->top_left.y &&
+           rect->top_left.x + rect->size.width <= container->top_left.x + container->size.width &&
+           rect->top_left.y + rect->size.height <= container->top_left.y + container->size.height;
+}
+
+// Part des bornes d'un enfant qui est visible dans son parent (les enfants sont clippés par le content_rect).
+static ei_rect_t child_contribution(ei_widget_t parent, const ei_rect_t* child_bounds) {
+    ei_rect_t contribution;
+    intersection_rect(&contribution, child_bounds, parent->content_rect);
+    return contribution;
+}
+
+// Recalcule entièrement les bornes d'un widget à partir de sa géométrie et de celles de ses enfants.
+static ei_rect_t compute_subtree_bounds(ei_widget_t widget) {
+    ei_rect_t bounds = widget->screen_location;
+    if (bounds.size.width <= 0 || bounds.size.height <= 0) {
+        return ei_rect_zero();
+    }
+    for (ei_widget_t child = widget->children_head; child != NULL; child = child->next_sibling) {
+        ei_rect_t contribution = child_contribution(widget, &child->subtree_bounds);
+        union_rect(&bounds, &bounds, &contribution);
+    }
+    return bounds;
+}
+
+void ei_impl_widget_update_subtree_bounds(ei_widget_t widget) {
+    assert(widget != NULL);
+
+    ei_rect_t old_bounds = widget->subtree_bounds;
+    widget->subtree_bounds = compute_subtree_bounds(widget);
+    ei_impl_spatial_index_child_moved(widget);
+
+    // Remonter tant que les bornes changent ; un parent n'est pas affecté si l'ancienne et la
+    // nouvelle contribution de l'enfant restent dans sa propre screen_location.
+    ei_widget_t child = widget;
+    ei_widget_t parent = widget->parent;
+    while (parent != NULL) {
+        ei_rect_t old_contribution = child_contribution(parent, &old_bounds);
+        ei_rect_t new_contribution = child_contribution(parent, &child->subtree_bounds);
+        if (rect_inside(&old_contribution, &parent->screen_location) &&
+            rect_inside(&new_contribution, &parent->screen_location)) {
+            break;
+        }
+        old_bounds = parent->subtree_bounds;
+        parent->subtree_bounds = compute_subtree_bounds(parent);
+        ei_impl_spatial_index_child_moved(parent);
+        if (memcmp(&old_bounds, &parent->subtree_bounds, sizeof(ei_rect_t)) == 0) {
+            break;
+        }
+        child = parent;
+        parent = parent->parent;
+    }
+}
+
+
+#define EI_IMPL_MAX_OCCLUDERS       16  // Rectangles opaques retenus lors du parcours avant -> arrière
+#define EI_IMPL_MAX_CLIP_PIECES     8   // Morceaux maximum du clipper d'un enfant
+#define EI_IMPL_MAX_DRAWN_PIECES    2   // Au-delà, l'enfant est dessiné une fois sur leur rectangle englobant
+#define EI_IMPL_DRAW_STACK_ITEMS    32  // Enfants traités sans allocation
+
+typedef struct {
+    ei_widget_t child;
+    int         nb_pieces;
+    ei_rect_t   pieces[EI_IMPL_MAX_CLIP_PIECES];
+} draw_item_t;
+
+// Retire un rectangle opaque des morceaux visibles d'un enfant.
+// Si le découpage dépasse EI_IMPL_MAX_CLIP_PIECES, l'occulteur est ignoré (on dessine un peu trop, jamais trop peu).
+static void draw_item_subtract(draw_item_t* item, const ei_rect_t* occluder) {
+    ei_rect_t result[EI_IMPL_MAX_CLIP_PIECES];
+    int nb_result = 0;
+
+    for (int i = 0; i < item->nb_pieces; i++) {
+        ei_rect_t remaining[4];
+        int nb_remaining = subtract_rect(remaining, &item->pieces[i], occluder);
+        if (nb_result + nb_remaining > EI_IMPL_MAX_CLIP_PIECES) {
+            return;
+        }
+        for (int j = 0; j < nb_remaining; j++) {
+            result[nb_result++] = remaining[j];
+        }
+    }
+
+    item->nb_pieces = nb_result;
+    for (int i = 0; i < nb_result; i++) {
+        item->pieces[i] = result[i];
+    }
+}
+
+// Ajoute un occulteur ; si la liste est pleine, il remplace le plus petit s'il est plus grand.
+static void add_occluder(ei_rect_t* occluders, int* nb_occluders, const ei_rect_t* rect) {
+    if (*nb_occluders < EI_IMPL_MAX_OCCLUDERS) {
+        occluders[(*nb_occluders)++] = *rect;
+        return;
+    }
+    int smallest = 0;
+    for (int i = 1; i < EI_IMPL_MAX_OCCLUDERS; i++) {
+        if (occluders[i].size.width * occluders[i].size.height <
+            occluders[smallest].size.width * occluders[smallest].size.height) {
+            smallest = i;
+        }
+    }
+    if (rect->size.width * rect->size.height >
+        occluders[smallest].size.width * occluders[smallest].size.height) {
+        occluders[smallest] = *rect;
+    }
+}
+
 void ei_impl_widget_draw_children(ei_widget_t widget,
                                  ei_surface_t surface,
                                  ei_surface_t pick_surface,
                                  ei_rect_t* clipper) {
     assert(widget != NULL && "Widget cannot be NULL");
     assert(surface != NULL && "Surface cannot be NULL");
-    assert(pick_surface != NULL && "Pick surface cannot be NULL");
 
     ei_impl_widget_t* impl_widget = (ei_impl_widget_t*)widget;
 
-    // Get the parent's content_rect
-    ei_rect_t parent_content_rect = *impl_widget->content_rect;
-
-    // Traverse all children
-    ei_widget_t child = impl_widget->children_head;
-    while (child != NULL) {
-        ei_impl_widget_t* child_impl = (ei_impl_widget_t*)child;
-
-        // Compute the effective clipper: intersection of parent's content_rect and provided clipper
-        ei_rect_t effective_clipper;
-        if (clipper != NULL) {
-            if (!intersection_rect(&effective_clipper, &parent_content_rect, clipper)) {
-                // No intersection, skip this child
-                child = child_impl->next_sibling;
-                continue;
-            }
+    // Clipper effectif, calculé une fois : intersection du content_rect du parent et du clipper donné
+    ei_rect_t effective_clipper = *impl_widget->content_rect;
+    if (clipper != NULL && !intersection_rect(&effective_clipper, impl_widget->content_rect, clipper)) {
+        return;
+    }
+
+    // Enfants qui coupent le clipper, dans l'ordre des frères (de l'arrière vers l'avant).
+    // Les grands conteneurs les obtiennent par leur index spatial au lieu de parcourir tous les enfants.
+    ei_widget_t* candidates = NULL;
+    size_t nb_candidates = 0;
+    size_t capacity = 0;
+    if (impl_widget->spatial_index != NULL) {
+        nb_candidates = ei_impl_spatial_index_query(widget, &effective_clipper, &candidates, &capacity);
+    } else {
+        nb_candidates = (size_t)impl_widget->nb_children;
+    }
+    if (nb_candidates == 0) {
+        free(candidates);
+        return;
+    }
+
+    draw_item_t stack_items[EI_IMPL_DRAW_STACK_ITEMS];
+    draw_item_t* items = stack_items;
+    if (nb_candidates > EI_IMPL_DRAW_STACK_ITEMS) {
+        items = malloc(nb_candidates * sizeof(draw_item_t));
+        assert(items != NULL && "Failed to allocate draw items");
+    }
+
+    int nb_items = 0;
+    ei_widget_t child = candidates != NULL ? candidates[0] : impl_widget->children_head;
+    for (size_t k = 1; child != NULL; k++) {
+        ei_rect_t intersection;
+        if (!ei_impl_widget_cache_skips(child) &&
+            intersection_rect(&intersection, &child->subtree_bounds, &effective_clipper)) {
+            items[nb_items].child = child;
+            items[nb_items].nb_pieces = 1;
+            items[nb_items].pieces[0] = intersection;
+            nb_items++;
+        }
+        if (candidates != NULL) {
+            child = k < nb_candidates ? candidates[k] : NULL;
         } else {
-            effective_clipper = parent_content_rect;
+            child = child->next_sibling;
+        }
+    }
+    free(candidates);
+
+    // De l'avant vers l'arrière : retirer de chaque enfant les zones couvertes par les frères opaques dessinés après lui
+    ei_rect_t occluders[EI_IMPL_MAX_OCCLUDERS];
+    int nb_occluders = 0;
+    for (int i = nb_items - 1; i >= 0; i--) {
+        for (int j = 0; j < nb_occluders && items[i].nb_pieces > 0; j++) {
+            draw_item_subtract(&items[i], &occluders[j]);
         }
 
-        // Check if child's screen_location intersects with the effective clipper
-        ei_rect_t child_rect = child_impl->screen_location;
-        ei_rect_t intersection;
-        if (intersection_rect(&intersection, &child_rect, &effective_clipper)) {
-            // Draw the child using its drawfunc
-            child_impl->wclass->drawfunc(child, surface, pick_surface, &intersection);
+        ei_rect_t opaque;
+        if (ei_impl_widget_opaque_rect(items[i].child, &opaque) &&
+            intersection_rect(&opaque, &opaque, &effective_clipper)) {
+            add_occluder(occluders, &nb_occluders, &opaque);
+        }
+    }
+
+    // De l'arrière vers l'avant : dessiner les morceaux visibles de chaque enfant
+    for (int i = 0; i < nb_items; i++) {
+        // Le drawfunc refait tout le dessin (texte, relief) à chaque morceau : au-delà de quelques
+        // morceaux, un seul appel sur leur rectangle englobant, les frères opaques recouvrent le reste
+        if (items[i].nb_pieces > EI_IMPL_MAX_DRAWN_PIECES) {
+            for (int p = 1; p < items[i].nb_pieces; p++) {
+                union_rect(&items[i].pieces[0], &items[i].pieces[0], &items[i].pieces[p]);
+            }
+            items[i].nb_pieces = 1;
+        }
+        for (int p = 0; p < items[i].nb_pieces; p++) {
+            if (!ei_impl_widget_cache_draw(items[i].child, surface, &items[i].pieces[p])) {
+                // Le picking des enfants est dessiné à part (voir ei_impl_widget_draw_pick)
+                items[i].child->wclass->drawfunc(items[i].child, surface, NULL, &items[i].pieces[p]);
+            }
+        }
+    }
+
+    if (items != stack_items) {
+        free(items);
+    }
+}
+
+// Écrit le pick_id du widget sur la partie de "area" où il est touché : tout le rectangle sans
+// hittestfunc, sinon ligne par ligne, par segments (les coins arrondis d'un bouton restent au
+// parent, comme en picking géométrique). La zone opaque est touchée sans appel au test.
+static void draw_pick_shape(ei_widget_t widget, const ei_rect_t* area) {
+    if (widget->wclass_ext == NULL || widget->wclass_ext->hittestfunc == NULL) {
+        ei_impl_pick_buffer_fill(pick_surface, widget->pick_id, area);
+        return;
+    }
+    ei_impl_hittestfunc_t hittest = widget->wclass_ext->hittestfunc;
+    ei_rect_t opaque;
+    if (!ei_impl_widget_opaque_rect(widget, &opaque)) {
+        opaque = ei_rect_zero();
+    }
+    int x_end = area->top_left.x + area->size.width;
+    int y_end = area->top_left.y + area->size.height;
+    for (int y = area->top_left.y; y < y_end; y++) {
+        bool in_opaque_rows = y >= opaque.top_left.y && y < opaque.top_left.y + opaque.size.height;
+        int opaque_end = opaque.top_left.x + opaque.size.width;
+        bool in_run = false;
+        int run_start = 0;
+        int x = area->top_left.x;
+        while (x < x_end) {
+            bool opaque_hit = in_opaque_rows && x >= opaque.top_left.x && x < opaque_end;
+            bool hit = opaque_hit || hittest(widget, &(ei_point_t){x, y});
+            if (hit && !in_run) {
+                in_run = true;
+                run_start = x;
+            } else if (!hit && in_run) {
+                ei_rect_t run = {{run_start, y}, {x - run_start, 1}};
+                ei_impl_pick_buffer_fill(pick_surface, widget->pick_id, &run);
+                in_run = false;
+            }
+            // La zone opaque est sautée d'un coup
+            x = opaque_hit ? opaque_end : x + 1;
+        }
+        if (in_run) {
+            ei_rect_t run = {{run_start, y}, {x_end - run_start, 1}};
+            ei_impl_pick_buffer_fill(pick_surface, widget->pick_id, &run);
         }
+    }
+}
 
-        // Move to the next sibling
-        child = child_impl->next_sibling;
+void ei_impl_widget_draw_pick(ei_widget_t widget, const ei_rect_t* clipper) {
+    assert(widget != NULL && clipper != NULL);
+    ei_rect_t area;
+    if (pick_surface == NULL || !intersection_rect(&area, &widget->subtree_bounds, clipper)) {
+        return;
+    }
+    if (intersection_rect(&area, &widget->screen_location, clipper)) {
+        // Classe sans extension privée : sa forme de picking vient de son drawfunc
+        if (widget->wclass_ext != NULL || !ei_impl_widget_render_pick(widget, &area)) {
+            draw_pick_shape(widget, &area);
+        }
+    }
+
+    ei_rect_t children_clipper;
+    if (widget->children_head == NULL || !intersection_rect(&children_clipper, widget->content_rect, clipper)) {
+        return;
+    }
+    if (widget->spatial_index != NULL) {
+        ei_widget_t* candidates = NULL;
+        size_t capacity = 0;
+        size_t nb = ei_impl_spatial_index_query(widget, &children_clipper, &candidates, &capacity);
+        for (size_t i = 0; i < nb; i++) {
+            ei_impl_widget_draw_pick(candidates[i], &children_clipper);
+        }
+        free(candidates);
+    } else {
+        for (ei_widget_t child = widget->children_head; child != NULL; child = child->next_sibling) {
+            ei_impl_widget_draw_pick(child, &children_clipper);
+        }
     }
 }
@@ -12,6 +12,8 @@
 #include "ei_types.h"     // Pour ei_widget_t, ei_color_t, ei_rect_t, ei_anchor_t, ei_relief_t
 #include "ei_widget.h"    // Pour ei_widget_destructor_t, ei_widgetclass_t (indirectement via ei_widget.h qui inclut ei_widgetclass.h)
 #include "ei_event.h"
+#include "ei_application.h" // Pour ei_live_resize_t
+#include "ei_drag.h"
 
 
 void ei_frame_register_class();
@@ -31,9 +33,9 @@ extern ei_widget_t active_widget ;
 extern ei_default_handle_func_t default_handle_func ;
 
 /**
- * \brief	Returns the picking offscreen surface used for widget identification.
- *
- * @return 			The picking surface.
+ * \brief	The picking offscreen used for widget identification. Not a hw surface: it points
+ *		to an ei_impl_pick_buffer_t (see ei_pick_buffer.h), only \ref ei_fill may draw into it.
+ *		NULL in geometric picking mode.
  */
 extern ei_surface_t pick_surface;
 
@@ -124,6 +126,15 @@ void draw_horizontal_line(ei_surface_t surface, int x1, int x2, int y, ei_color_
  */
 bool intersection_rect(ei_rect_t* dest, const ei_rect_t* a, const ei_rect_t* b);
 
+/**
+ * @brief   Computes the bounding box of two rectangles. An empty rectangle is ignored.
+ *
+ * @param   dest    The rectangle to store the result (may be a or b).
+ * @param   a       The first input rectangle.
+ * @param   b       The second input rectangle.
+ */
+void union_rect(ei_rect_t* dest, const ei_rect_t* a, const ei_rect_t* b);
+
 /**
  * @brief   Clamps a rectangle to surface boundaries to prevent out-of-bounds drawing.
  *
@@ -133,6 +144,104 @@ bool intersection_rect(ei_rect_t* dest, const ei_rect_t* a, const ei_rect_t* b);
 void clamp_rect_to_surface(ei_rect_t* rect, ei_surface_t surface);
 
 
+/**
+ * @brief   Subtracts rectangle b from rectangle a.
+ *          The remaining area is written as at most 4 disjoint rectangles.
+ *
+ * @param   dest    Array of at least 4 rectangles receiving the pieces of a that are outside of b.
+ * @param   a       The rectangle to subtract from.
+ * @param   b       The rectangle to subtract.
+ *
+ * @return  The number of rectangles written in dest (0 if b covers a entirely).
+ */
+int subtract_rect(ei_rect_t dest[4], const ei_rect_t* a, const ei_rect_t* b);
+
+
+/**
+ * \brief	A function that tells which part of a widget is fully covered by its drawing.
+ *		Siblings placed below the widget do not need to be drawn in this area.
+ *
+ * @param	widget		The widget.
+ * @param	opaque_rect	Where to store the opaque area, in screen coordinates.
+ *
+ * @return			true if opaque_rect was set, false if the widget does not guarantee
+ *				to cover any part of its screen_location.
+ */
+typedef bool	(*ei_impl_opaquefunc_t)		(ei_widget_t widget, ei_rect_t* opaque_rect);
+
+/**
+ * \brief	A function that tells if a point of the screen_location of a widget belongs to
+ *		the widget, for geometric picking (see \ref ei_picking_geometric).
+ *		Classes without this hook are hit on their whole screen_location.
+ *
+ * @param	widget		The widget.
+ * @param	where		A point of the screen_location of the widget.
+ *
+ * @return			true if the widget is hit at this point.
+ */
+typedef bool	(*ei_impl_hittestfunc_t)	(ei_widget_t widget, const ei_point_t* where);
+
+/**
+ * \brief	A function that reports what a widget draws on top of its children (after
+ *		having drawn them), e.g. the resize handle of a toplevel.
+ *
+ * @param	widget		The widget.
+ * @param	overlay_rect	Where to store the area drawn over the children, in screen coordinates.
+ *
+ * @return			false if the widget draws nothing over its children.
+ */
+typedef bool	(*ei_impl_overlayfunc_t)	(ei_widget_t widget, ei_rect_t* overlay_rect);
+
+/**
+ * \brief	Geometry changes that leave the rendering of a widget unchanged where its old and
+ *		new locations overlap (see \ref ei_impl_invariancefunc_t).
+ */
+typedef enum {
+    ei_impl_invariant_none		= 0,
+    ei_impl_invariant_translation	= 1 << 0,	///< Moving the widget without resizing it.
+    ei_impl_invariant_resize		= 1 << 1	///< Resizing the widget without moving its top left corner.
+} ei_impl_invariance_t;
+
+/**
+ * \brief	A function that reports which geometry changes keep the pixels (and pick ids) of a
+ *		widget where its old and new locations overlap, e.g. a plain frame. The placer then
+ *		invalidates only the symmetric difference of the two locations.
+ *		Classes without this hook are redrawn over their whole new location.
+ *
+ * @param	widget		The widget, with its current attributes.
+ *
+ * @return			A combination of \ref ei_impl_invariance_t flags.
+ */
+typedef int	(*ei_impl_invariancefunc_t)	(ei_widget_t widget);
+
+/**
+ * \brief	Private extension of a widget class. Holds the hooks that are not part of the
+ *		public \ref ei_widgetclass_t, so that classes compiled against the public API
+ *		(such as the external "testclass") keep working unchanged.
+ *		Classes without an extension get conservative defaults.
+ */
+typedef struct ei_impl_widgetclass_ext_t {
+    ei_widgetclass_t*			wclass;		///< The class this extension belongs to.
+    ei_impl_opaquefunc_t		opaquefunc;	///< Reports the opaque area of a widget. May be NULL.
+    ei_impl_hittestfunc_t		hittestfunc;	///< Geometric hit test of a widget. May be NULL.
+    ei_impl_overlayfunc_t		overlayfunc;	///< Area drawn over the children. NULL if the class draws nothing over them.
+    ei_impl_invariancefunc_t		invariancefunc;	///< Geometry changes that keep the rendering. May be NULL.
+    struct ei_impl_widgetclass_ext_t*	next;		///< Next extension in the registry.
+} ei_impl_widgetclass_ext_t;
+
+/**
+ * \brief	Registers the private extension of a class. The structure is not copied.
+ *
+ * @param	ext		The extension, its wclass field must be set.
+ */
+void ei_impl_widgetclass_register_ext(ei_impl_widgetclass_ext_t* ext);
+
+/**
+ * \brief	Returns the private extension of a class, or NULL if it has none.
+ */
+ei_impl_widgetclass_ext_t* ei_impl_widgetclass_ext_from_class(const ei_widgetclass_t* wclass);
+
+
 /**
  * \brief	A structure storing the placement parameters of a widget.
  *		You have to define this structure: no suggestion provided.
@@ -149,6 +258,13 @@ typedef struct ei_impl_placer_params_t {
     float       rel_width;
     float       rel_height;
 
+    ei_point_t  parent_origin;      ///< top_left of the parent's content_rect at the last placement.
+
+    // Résultat du dernier calcul, réutilisé tant que ses entrées n'ont pas changé
+    bool        dirty;              ///< true if the parameters above changed since the last computation.
+    ei_size_t   parent_size;        ///< Size of the parent's content_rect used by the last computation.
+    ei_size_t   requested_size;     ///< Requested size of the widget used by the last computation.
+    ei_rect_t   layout;             ///< Computed geometry, relative to the top_left of the parent's content_rect.
 
 } ei_impl_placer_params_t;
 
@@ -162,13 +278,25 @@ typedef struct ei_impl_placer_params_t {
  */
 void ei_impl_placer_run(ei_widget_t widget);
 
+/**
+ * \brief	Places the widgets queued by the current layout transaction (see \ref ei_layout_begin).
+ *		Does nothing if no widget is queued.
+ */
+void ei_impl_layout_flush(void);
+
+/**
+ * \brief	Frees the queue of the layout transactions. Called by \ref ei_app_free.
+ */
+void ei_impl_layout_release(void);
+
 /**
  * \brief	Fields common to all types of widget. Every widget classes specializes this base
  *		class by adding its own fields.
  */
 typedef struct ei_impl_widget_t {
     ei_widgetclass_t* wclass;        ///< The class of widget of this widget. Avoids the field name "class" which is a keyword in C++.
-    uint32_t   pick_id;                ///< Id of this widget in the picking offscreen.
+    ei_impl_widgetclass_ext_t* wclass_ext; ///< Private hooks of the class, NULL for classes registered through the public API only.
+    uint32_t   pick_id;                ///< Id of this widget in the picking offscreen: small, unique among live widgets, reused after destruction.
     ei_color_t pick_color;           ///< pick_id encoded as a color.
     void*      user_data;                 ///< Pointer provided by the programmer for private use. May be NULL.
     ei_widget_destructor_t destructor; ///< Pointer to the programmer's function to call before destroying this widget. May be NULL.
@@ -178,13 +306,29 @@ typedef struct ei_impl_widget_t {
     ei_widget_t children_head;      ///< Pointer to the first child of this widget. Children are chained with the "next_sibling" field.
     ei_widget_t children_tail;       ///< Pointer to the last child of this widget.
     ei_widget_t next_sibling;        ///< Pointer to the next child of this widget's parent widget.
+    ei_widget_t prev_sibling;        ///< Pointer to the previous child of this widget's parent widget.
 
     /* Geometry Management */
     ei_impl_placer_params_t* placer_params; ///< Pointer to the placer parameters for this widget. If NULL, the widget is not currently managed and thus, is not displayed on the screen.
     ei_size_t requested_size;        ///< See \ref ei_widget_get_requested_size.
     ei_rect_t screen_location;       ///< See \ref ei_widget_get_screen_location.
     ei_rect_t* content_rect;        ///< See ei_widget_get_content_rect. By defaults, points to the screen_location.
-    
+    ei_rect_t subtree_bounds;        ///< Area that this widget and its descendants can paint: screen_location plus the children's bounds clipped to content_rect. Empty when not displayed.
+
+    /* Spatial indexing of the children */
+    int        nb_children;          ///< Number of children of this widget.
+    uint32_t   z_order;              ///< Stacking rank among the siblings: higher is drawn later (on top).
+    uint32_t   next_z_order;         ///< z_order given to the next child of this widget.
+    struct ei_impl_spatial_index_t* spatial_index; ///< Index over the children's subtree_bounds, NULL for small containers (see ei_spatial_index.h).
+    ei_rect_t  indexed_bounds;       ///< subtree_bounds at the time this widget was inserted in its parent's index.
+    uint32_t   index_stamp;          ///< Used by the parent's index to report each child only once per query.
+
+    struct ei_impl_widget_cache_t* cache; ///< Retained rendering of the subtree, NULL if not cached (see ei_widget_cache.h).
+    bool       layer;                ///< Composited over the cache of the root widget instead of being part of it.
+    struct ei_impl_timer_t* timers;  ///< Timers owned by this widget, cancelled on destruction (see ei_timer.h).
+    struct ei_impl_animated_t* animated; ///< Running animations of the placer parameters, NULL if none (see ei_animate.h).
+    int        layout_slot;          ///< 1 + index in the queue of the current layout transaction, 0 if not queued.
+
 } ei_impl_widget_t;
 
 typedef struct ei_impl_button_t {
@@ -252,9 +396,14 @@ typedef struct ei_impl_toplevel_t {
     // Internal states for drag and resize operations
     bool is_moving;                   ///< True if the toplevel is being dragged
     bool is_resizing;                 ///< True if the toplevel is being resized
-    ei_point_t drag_start_pos;        ///< Mouse position at the start of drag/resize
-    ei_point_t widget_start_pos;      ///< Widget position at the start of drag
-    ei_size_t widget_start_size;      ///< Widget content size at the start of resize
+    ei_drag_t drag;                   ///< Pointer tracking of the drag/resize: origin is the position or the content size
+    struct ei_impl_timer_t* drag_settle_timer; ///< Pending correction of a predicted position, NULL if none
+
+    // Live resize (see ei_app_set_live_resize)
+    uint32_t* resize_preview;         ///< Last full rendering of the content during a resize, NULL if none
+    ei_size_t resize_preview_size;    ///< Size of the content rendered in resize_preview
+    double resize_relayout_time;      ///< hw_now() at the last full relayout of the resize
+    struct ei_impl_timer_t* resize_relayout_timer; ///< Pending full relayout, NULL if none
 
 } ei_impl_toplevel_t;
 
@@ -262,11 +411,12 @@ typedef struct ei_impl_toplevel_t {
 /**
  * @brief	Draws the children of a widget.
  * 		The children are drawn within the limits of the clipper and
- * 		the widget's content_rect.
+ * 		the widget's content_rect. The areas of a child that are covered by the
+ * 		opaque area of a later sibling (see \ref ei_impl_widget_opaque_rect) are not drawn.
  *
  * @param	widget		The widget whose children are drawn.
  * @param	surface		A locked surface where to draw the widget's children.
- * @param	pick_surface	The picking offscreen.
+ * @param	pick_surface	The picking offscreen, or NULL when it is not drawn (see ei_impl_widget_draw_pick).
 * @param	clipper		If not NULL, the drawing is restricted within this rectangle
  * (expressed in the surface reference frame).
  */
@@ -275,6 +425,177 @@ void ei_impl_widget_draw_children(ei_widget_t widget,
                                  ei_surface_t pick_surface,
                                  ei_rect_t* clipper);
 
+/**
+ * @brief	Same as \ref ei_app_invalidate_rect, for a change that does not modify the geometry
+ *		nor the stacking order of widgets (colors, relief, text, pressed state...):
+ *		the rectangle is redrawn but the pick buffer is left as is.
+ *
+ * @param	rect		The rectangle to redraw, in screen coordinates.
+ */
+void ei_impl_app_invalidate_paint(const ei_rect_t* rect);
+
+/**
+ * @brief	Marks a rectangle of the pick buffer as out of date, without redrawing it: for a
+ *		change of the shape hit by a widget (see \ref ei_impl_hittestfunc_t) that is
+ *		repainted separately.
+ *
+ * @param	rect		The rectangle, in screen coordinates.
+ */
+void ei_impl_app_invalidate_pick(const ei_rect_t* rect);
+
+/**
+ * @brief	Invalidates a region made of disjoint rectangles, such as the difference between
+ *		the old and new locations of a widget. Unlike \ref ei_app_invalidate_rect, the
+ *		rectangles are not merged with the invalidated rectangles they only touch, which
+ *		would also redraw the area between them.
+ *
+ * @param	rects		The rectangles, in screen coordinates. Empty ones are ignored.
+ * @param	nb_rects	The number of rectangles.
+ * @param	geometry	true if the geometry or the stacking order changed in the region
+ *				(the pick buffer is invalidated too), false for a change of rendering only.
+ */
+void ei_impl_app_invalidate_region(const ei_rect_t* rects, int nb_rects, bool geometry);
+
+/**
+ * @brief	Queues the redraw of a rectangle, starting from "start" instead of the root widget
+ *		(see \ref ei_widget_repaint). The caller guarantees that "start" is opaque over the
+ *		rectangle and that no widget drawn after "start" overlaps it.
+ *
+ * @param	start		The widget whose drawfunc is called.
+ * @param	rect		The rectangle to redraw, in screen coordinates.
+ */
+void ei_impl_app_queue_repaint(ei_widget_t start, const ei_rect_t* rect);
+
+/**
+ * @brief	Records that the pixels of a rectangle moved on screen without changing: at the
+ *		next redraw they are copied from "from" to "to" on the root surface, and only the
+ *		part of "from" that the copy does not cover is redrawn. The pick buffer is
+ *		invalidated over both rectangles.
+ *		The caller guarantees that both rectangles show only the moved widget (see
+ *		\ref ei_impl_widget_is_unobscured).
+ *
+ * @param	from		The previous location, in screen coordinates.
+ * @param	to		The new top left corner.
+ *
+ * @return			false if the pixels of "from" on the root surface are not up to date
+ *				(pending damage): nothing is recorded and the caller must invalidate
+ *				both rectangles.
+ */
+bool ei_impl_app_move_rect(const ei_rect_t* from, ei_point_t to);
+
+/**
+ * @brief	Removes the queued repaints that start from a widget, which is being destroyed.
+ */
+void ei_impl_app_cancel_repaints(ei_widget_t widget);
+
+/**
+ * @brief	Returns the live resize mode of the toplevels (see \ref ei_app_set_live_resize).
+ *
+ * @param	relayout_ms	If not NULL, receives the minimal delay between two full relayouts.
+ */
+ei_live_resize_t ei_impl_app_live_resize(int* relayout_ms);
+
+/**
+ * @brief	Starts or continues a direct manipulation (move or resize of a toplevel): the
+ *		drawing quality is lowered (see \ref ei_app_set_interaction_quality) until
+ *		\ref ei_impl_app_end_interaction, or until this function is not called for
+ *		EI_INTERACTION_IDLE_MS milliseconds.
+ */
+void ei_impl_app_begin_interaction(void);
+
+/**
+ * @brief	Ends a direct manipulation: the areas drawn at low quality are invalidated.
+ */
+void ei_impl_app_end_interaction(void);
+
+/**
+ * @brief	Returns true if the draw functions must draw at low quality.
+ */
+bool ei_impl_app_low_quality(void);
+
+/**
+ * @brief	Returns true if the drags extrapolate the pointer motion (see \ref ei_app_set_motion_prediction).
+ */
+bool ei_impl_app_motion_prediction(void);
+
+/**
+ * @brief	Returns the date (\ref hw_now) at which the changes made now are expected on screen.
+ */
+double ei_impl_app_expected_present(void);
+
+/**
+ * @brief	Counts a sample of the drag lag in the statistics (see \ref ei_app_stats_t).
+ *
+ * @param	distance	The distance between the drawn and the exact positions, in pixels.
+ */
+void ei_impl_app_note_drag_lag(double distance);
+
+/**
+ * @brief	Frees the text renderings kept while drawing at low quality (see \ref ei_draw_text).
+ */
+void ei_impl_text_cache_clear(void);
+
+/**
+ * @brief	Returns true if an event is the wake-up of the timers (see ei_timer.h). The main
+ *		loop does not dispatch it but calls \ref ei_impl_timer_run.
+ */
+bool ei_impl_timer_is_tick(const ei_event_t* event);
+
+/**
+ * @brief	Calls back the timers that expired, then schedules the wake-up of the next ones.
+ */
+void ei_impl_timer_run(void);
+
+/**
+ * @brief	Frees all the timers. Called by \ref ei_app_free.
+ */
+void ei_impl_timer_release(void);
+
+/**
+ * @brief	Renders a widget and its descendants in the pick buffer (see ei_pick_buffer.h),
+ *		each one filling its screen_location with its pick_id, children clipped to
+ *		the content_rect of their parent. Used to render the pending pick region.
+ *
+ * @param	widget		The widget, usually the root widget.
+ * @param	clipper		The rendering is restricted within this rectangle.
+ */
+void ei_impl_widget_draw_pick(ei_widget_t widget, const ei_rect_t* clipper);
+
+/**
+ * @brief	Recomputes the subtree bounds of a widget after its geometry (or the geometry of
+ *		one of its children) changed, and propagates the change to its ancestors.
+ *		Propagation stops at the first ancestor whose bounds are not affected.
+ *
+ * @param	widget		The widget whose geometry changed.
+ */
+void ei_impl_widget_update_subtree_bounds(ei_widget_t widget);
+
+/**
+ * @brief	Returns the area of a widget that is fully covered when it is drawn.
+ *
+ * @param	widget		The widget.
+ * @param	opaque_rect	Where to store the opaque area, in screen coordinates.
+ *
+ * @return			false if the class cannot guarantee any opaque area.
+ */
+bool ei_impl_widget_opaque_rect(ei_widget_t widget, ei_rect_t* opaque_rect);
+
+/**
+ * @brief	Returns the geometry changes that keep the rendering of a widget (see
+ *		\ref ei_impl_invariancefunc_t), ei_impl_invariant_none for classes without the hook.
+ */
+int ei_impl_widget_invariance(ei_widget_t widget);
+
+/**
+ * @brief	Tells if a rectangle, in which a widget draws, is entirely visible on screen: inside
+ *		the content_rect of all the ancestors, and not overlapped by anything drawn after
+ *		the widget (later siblings of the widget and of its ancestors, ancestor overlays).
+ *
+ * @param	widget		The widget.
+ * @param	rect		The rectangle, in screen coordinates.
+ */
+bool ei_impl_widget_is_unobscured(ei_widget_t widget, const ei_rect_t* rect);
+
 /**
  * \brief	Converts the red, green, blue and alpha components of a color into a 32 bits integer
  * 		than can be written directly in the memory returned by \ref hw_surface_get_buffer.
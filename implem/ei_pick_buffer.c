@@ -0,0 +1,151 @@
+#include "ei_pick_buffer.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EI_PICK_MAX_PENDING     16  // Au-delà, les rectangles en attente sont fusionnés
+
+struct ei_impl_pick_buffer_t {
+    ei_size_t size;
+    int       bytes_per_id;     // 2 ou 3
+    uint8_t*  ids;              // size.width * size.height ids, ligne par ligne
+    int       nb_pending;
+    ei_rect_t pending[EI_PICK_MAX_PENDING]; // Zones à rendre avant d'être lues
+};
+
+
+static int bytes_for_id(uint32_t max_id) {
+    return max_id <= 0xFFFF ? 2 : 3;
+}
+
+ei_impl_pick_buffer_t* ei_impl_pick_buffer_create(ei_size_t size, uint32_t max_id) {
+    ei_impl_pick_buffer_t* buffer = malloc(sizeof(ei_impl_pick_buffer_t));
+    assert(buffer != NULL && "Failed to allocate the pick buffer");
+    buffer->size = size;
+    buffer->nb_pending = 0;
+    buffer->bytes_per_id = bytes_for_id(max_id);
+    buffer->ids = calloc((size_t)size.width * size.height, buffer->bytes_per_id);
+    assert(buffer->ids != NULL && "Failed to allocate the pick buffer");
+    return buffer;
+}
+
+void ei_impl_pick_buffer_free(ei_impl_pick_buffer_t* buffer) {
+    if (buffer == NULL) {
+        return;
+    }
+    free(buffer->ids);
+    free(buffer);
+}
+
+void ei_impl_pick_buffer_reserve(ei_impl_pick_buffer_t* buffer, uint32_t max_id) {
+    if (bytes_for_id(max_id) <= buffer->bytes_per_id) {
+        return;
+    }
+    // Passage de 16 à 24 bits : on élargit en place, de la fin vers le début
+    size_t nb_pixels = (size_t)buffer->size.width * buffer->size.height;
+    uint8_t* ids = realloc(buffer->ids, nb_pixels * 3);
+    assert(ids != NULL && "Failed to widen the pick buffer");
+    const uint16_t* ids16 = (const uint16_t*)ids;
+    for (size_t i = nb_pixels; i-- > 0;) {
+        uint16_t id = ids16[i];
+        ids[3 * i]     = (uint8_t)id;
+        ids[3 * i + 1] = (uint8_t)(id >> 8);
+        ids[3 * i + 2] = 0;
+    }
+    buffer->ids = ids;
+    buffer->bytes_per_id = 3;
+}
+
+void ei_impl_pick_buffer_fill(ei_impl_pick_buffer_t* buffer, uint32_t id, const ei_rect_t* clipper) {
+    int x_min = 0, y_min = 0;
+    int x_max = buffer->size.width, y_max = buffer->size.height;
+    if (clipper != NULL) {
+        if (clipper->top_left.x > x_min) x_min = clipper->top_left.x;
+        if (clipper->top_left.y > y_min) y_min = clipper->top_left.y;
+        if (clipper->top_left.x + clipper->size.width < x_max) x_max = clipper->top_left.x + clipper->size.width;
+        if (clipper->top_left.y + clipper->size.height < y_max) y_max = clipper->top_left.y + clipper->size.height;
+    }
+    if (x_min >= x_max || y_min >= y_max) {
+        return;
+    }
+    int width = x_max - x_min;
+
+    if (buffer->bytes_per_id == 2) {
+        uint16_t value = (uint16_t)id;
+        for (int y = y_min; y < y_max; y++) {
+            uint16_t* span = (uint16_t*)buffer->ids + (size_t)y * buffer->size.width + x_min;
+            if (value == 0) {
+                memset(span, 0, width * sizeof(uint16_t));
+            } else {
+                for (int x = 0; x < width; x++) {
+                    span[x] = value;
+                }
+            }
+        }
+        return;
+    }
+
+    // 24 bits : la première ligne est écrite octet par octet, les suivantes en sont des copies
+    uint8_t b0 = (uint8_t)id, b1 = (uint8_t)(id >> 8), b2 = (uint8_t)(id >> 16);
+    uint8_t* first = buffer->ids + ((size_t)y_min * buffer->size.width + x_min) * 3;
+    for (int x = 0; x < width; x++) {
+        first[3 * x]     = b0;
+        first[3 * x + 1] = b1;
+        first[3 * x + 2] = b2;
+    }
+    for (int y = y_min + 1; y < y_max; y++) {
+        memcpy(buffer->ids + ((size_t)y * buffer->size.width + x_min) * 3, first, (size_t)width * 3);
+    }
+}
+
+ei_size_t ei_impl_pick_buffer_size(const ei_impl_pick_buffer_t* buffer) {
+    return buffer->size;
+}
+
+uint32_t ei_impl_pick_buffer_get(const ei_impl_pick_buffer_t* buffer, ei_point_t where) {
+    if (where.x < 0 || where.y < 0 || where.x >= buffer->size.width || where.y >= buffer->size.height) {
+        return 0;
+    }
+    size_t index = (size_t)where.y * buffer->size.width + where.x;
+    if (buffer->bytes_per_id == 2) {
+        return ((const uint16_t*)buffer->ids)[index];
+    }
+    const uint8_t* id = buffer->ids + 3 * index;
+    return id[0] | ((uint32_t)id[1] << 8) | ((uint32_t)id[2] << 16);
+}
+
+static bool rect_contains_point(const ei_rect_t* rect, ei_point_t point) {
+    return point.x >= rect->top_left.x && point.x < rect->top_left.x + rect->size.width &&
+           point.y >= rect->top_left.y && point.y < rect->top_left.y + rect->size.height;
+}
+
+static ei_rect_t rect_bounding(const ei_rect_t* a, const ei_rect_t* b) {
+    int x_min = a->top_left.x < b->top_left.x ? a->top_left.x : b->top_left.x;
+    int y_min = a->top_left.y < b->top_left.y ? a->top_left.y : b->top_left.y;
+    int x_a = a->top_left.x + a->size.width, x_b = b->top_left.x + b->size.width;
+    int y_a = a->top_left.y + a->size.height, y_b = b->top_left.y + b->size.height;
+    ei_rect_t result = { {x_min, y_min}, {(x_a > x_b ? x_a : x_b) - x_min, (y_a > y_b ? y_a : y_b) - y_min} };
+    return result;
+}
+
+void ei_impl_pick_buffer_invalidate(ei_impl_pick_buffer_t* buffer, const ei_rect_t* rect) {
+    if (rect->size.width <= 0 || rect->size.height <= 0) {
+        return;
+    }
+    if (buffer->nb_pending < EI_PICK_MAX_PENDING) {
+        buffer->pending[buffer->nb_pending++] = *rect;
+    } else {
+        buffer->pending[EI_PICK_MAX_PENDING - 1] = rect_bounding(&buffer->pending[EI_PICK_MAX_PENDING - 1], rect);
+    }
+}
+
+bool ei_impl_pick_buffer_take_pending(ei_impl_pick_buffer_t* buffer, ei_point_t where, ei_rect_t* rect) {
+    for (int i = 0; i < buffer->nb_pending; i++) {
+        if (rect_contains_point(&buffer->pending[i], where)) {
+            *rect = buffer->pending[i];
+            buffer->pending[i] = buffer->pending[--buffer->nb_pending];
+            return true;
+        }
+    }
+    return false;
+}
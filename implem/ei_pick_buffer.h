@@ -0,0 +1,91 @@
+/**
+ * @file  ei_pick_buffer.h
+ *
+ * @brief Picking offscreen: one widget pick_id per pixel, stored on 16 bits while all ids
+ *        fit, on 24 bits beyond. Replaces a 32-bit RGBA surface holding ids encoded as colors.
+ *        The global \ref pick_surface points to the buffer of the application and \ref ei_fill
+ *        recognizes it, as do ei_draw_polygon and ei_draw_polyline: the drawfuncs of the classes
+ *        without private hooks draw their pick shape with their pick_color. ei_draw_text and
+ *        ei_copy_surface ignore it (it is not an hw surface).
+ *
+ *        The buffer is rendered lazily: redraws only record the damaged rectangles as pending,
+ *        they are rendered when \ref ei_widget_pick reads a pixel inside one of them.
+ *
+ */
+
+#ifndef EI_PICK_BUFFER_H
+#define EI_PICK_BUFFER_H
+
+#include "ei_types.h"
+#include <stdint.h>
+
+/**
+ * \brief	Opaque pick buffer.
+ */
+typedef struct ei_impl_pick_buffer_t ei_impl_pick_buffer_t;
+
+/**
+ * \brief	Creates a pick buffer cleared to 0 (no widget).
+ *
+ * @param	size		Size of the buffer, in pixels.
+ * @param	max_id		Highest pick_id that the buffer must be able to store.
+ */
+ei_impl_pick_buffer_t* ei_impl_pick_buffer_create(ei_size_t size, uint32_t max_id);
+
+/**
+ * \brief	Frees a pick buffer.
+ */
+void ei_impl_pick_buffer_free(ei_impl_pick_buffer_t* buffer);
+
+/**
+ * \brief	Widens the buffer, keeping its content, if max_id does not fit in the current width.
+ */
+void ei_impl_pick_buffer_reserve(ei_impl_pick_buffer_t* buffer, uint32_t max_id);
+
+/**
+ * \brief	Fills a rectangle of the buffer with a pick_id.
+ *
+ * @param	buffer		The buffer.
+ * @param	id		The pick_id, 0 to clear.
+ * @param	clipper		The rectangle, clipped to the buffer. NULL for the whole buffer.
+ */
+void ei_impl_pick_buffer_fill(ei_impl_pick_buffer_t* buffer, uint32_t id, const ei_rect_t* clipper);
+
+/**
+ * \brief	Returns the size of the buffer, in pixels.
+ */
+ei_size_t ei_impl_pick_buffer_size(const ei_impl_pick_buffer_t* buffer);
+
+/**
+ * \brief	Returns the pick_id at a point, 0 if no widget or if the point is outside of the buffer.
+ */
+uint32_t ei_impl_pick_buffer_get(const ei_impl_pick_buffer_t* buffer, ei_point_t where);
+
+/**
+ * \brief	Records a rectangle whose content is out of date.
+ */
+void ei_impl_pick_buffer_invalidate(ei_impl_pick_buffer_t* buffer, const ei_rect_t* rect);
+
+/**
+ * \brief	Removes from the pending region one rectangle that contains a point.
+ *
+ * @param	buffer		The buffer.
+ * @param	where		The point about to be read.
+ * @param	rect		Where to store the rectangle that must be rendered before reading.
+ *
+ * @return			false if the pixel at "where" is up to date.
+ */
+bool ei_impl_pick_buffer_take_pending(ei_impl_pick_buffer_t* buffer, ei_point_t where, ei_rect_t* rect);
+
+/**
+ * \brief	Converts a pick_color to the pick_id it encodes (see \ref ei_impl_widget_t).
+ *		A transparent color gives 0.
+ */
+static inline uint32_t ei_impl_pick_id_from_color(const ei_color_t* color)
+{
+	if (color->alpha == 0)
+		return 0;
+	return ((uint32_t)color->red << 16) | ((uint32_t)color->green << 8) | color->blue;
+}
+
+#endif
@@ -7,59 +7,156 @@
 #include <string.h>
 #include "ei_placer.h"
 #include "ei_utils.h"
+#include "ei_widget_cache.h"
+#include "ei_spatial_index.h"
+#include "ei_animate.h"
 
+// Widget dont le geomnotifyfunc est en cours. Ses enfants qui le suivent sans changer de taille
+// n'ont rien à invalider : la fin de son placement invalide (ou déplace) toute sa zone.
+static ei_widget_t g_placing_widget = NULL;
+static int         g_nb_followers   = 0;    // Enfants de g_placing_widget qui l'ont suivi avec tout leur sous-arbre
 
-// Dans ei_placer.c
-void ei_impl_placer_run(ei_widget_t widget) {
-    ei_impl_widget_t* impl_widget = (ei_impl_widget_t*)widget;
-    assert(impl_widget->placer_params != NULL && "hmm , pas de placer_params");
+// Transactions de placement (voir ei_layout_begin) : les widgets à placer attendent le commit.
+static int          g_layout_depth      = 0;
+static bool         g_layout_flushing   = false;
+static ei_widget_t* g_layout_queue      = NULL;     // Les widgets retirés de la file y sont remplacés par NULL
+static int          g_layout_nb         = 0;
+static int          g_layout_size       = 0;
 
+typedef struct layout_entry_t {
+    ei_widget_t widget;
+    int         depth;
+    int         order;
+} layout_entry_t;
 
-    ei_impl_placer_params_t* params = impl_widget->placer_params;
+static bool layout_enqueue(ei_widget_t widget) {
+    if (widget->layout_slot != 0) {
+        return true;
+    }
+    if (g_layout_nb == g_layout_size) {
+        int size = g_layout_size == 0 ? 64 : 2 * g_layout_size;
+        ei_widget_t* queue = realloc(g_layout_queue, size * sizeof(ei_widget_t));
+        if (queue == NULL) {
+            return false;
+        }
+        g_layout_queue = queue;
+        g_layout_size = size;
+    }
+    g_layout_queue[g_layout_nb++] = widget;
+    widget->layout_slot = g_layout_nb;
+    return true;
+}
 
-    // Stocker l'ancienne position pour invalidation
-    ei_rect_t old_screen_location = impl_widget->screen_location;
+static void layout_dequeue(ei_widget_t widget) {
+    if (widget->layout_slot != 0) {
+        g_layout_queue[widget->layout_slot - 1] = NULL;
+        widget->layout_slot = 0;
+    }
+}
 
-    // Get parent’s content_rect (or root surface size for root widget)
-    ei_rect_t parent_rect;
-    if (impl_widget->parent != NULL) {
-        parent_rect = *(((ei_impl_widget_t*)impl_widget->parent)->content_rect);
-    } else {
-        // Root widget: use the size of the root surface
-        ei_size_t surface_size = hw_surface_get_size(ei_app_root_surface());
-        parent_rect.top_left = (ei_point_t){0, 0};
-        parent_rect.size = surface_size;
+static int compare_layout_entries(const void* a, const void* b) {
+    const layout_entry_t* ea = a;
+    const layout_entry_t* eb = b;
+    if (ea->depth != eb->depth) {
+        return ea->depth - eb->depth;
+    }
+    return ea->order - eb->order;
+}
+
+void ei_layout_begin(void) {
+    g_layout_depth++;
+}
+
+void ei_layout_commit(void) {
+    assert(g_layout_depth > 0 && "ei_layout_commit without ei_layout_begin");
+    if (--g_layout_depth == 0) {
+        ei_impl_layout_flush();
     }
+}
 
+void ei_impl_layout_flush(void) {
+    if (g_layout_nb == 0 || g_layout_flushing) {
+        return;
+    }
+    g_layout_flushing = true;
+
+    // Les parents d'abord : le placement d'un toplevel replace ses enfants, qui quittent alors la file
+    int nb = 0;
+    layout_entry_t* entries = malloc(g_layout_nb * sizeof(layout_entry_t));
+    for (int i = 0; i < g_layout_nb; i++) {
+        ei_widget_t widget = g_layout_queue[i];
+        if (widget == NULL) {
+            continue;
+        }
+        if (entries == NULL) {
+            // Pas de mémoire pour trier : dans l'ordre des demandes
+            ei_impl_placer_run(widget);
+            continue;
+        }
+        int depth = 0;
+        for (ei_widget_t ancestor = widget->parent; ancestor != NULL; ancestor = ancestor->parent) {
+            depth++;
+        }
+        entries[nb++] = (layout_entry_t){widget, depth, i};
+    }
+    if (entries != NULL) {
+        qsort(entries, nb, sizeof(layout_entry_t), compare_layout_entries);
+        for (int i = 0; i < nb; i++) {
+            if (entries[i].widget->layout_slot != 0) {
+                ei_impl_placer_run(entries[i].widget);
+            }
+        }
+        free(entries);
+    }
+
+    g_layout_nb = 0;
+    g_layout_flushing = false;
+}
+
+void ei_impl_layout_release(void) {
+    free(g_layout_queue);
+    g_layout_queue = NULL;
+    g_layout_nb = 0;
+    g_layout_size = 0;
+}
+
+// Vrai si le widget cache entièrement tout ce qu'il y a derrière lui.
+static bool is_opaque(ei_widget_t widget) {
+    ei_rect_t opaque, inter;
+    return ei_impl_widget_opaque_rect(widget, &opaque) &&
+           intersection_rect(&inter, &opaque, &widget->screen_location) &&
+           memcmp(&inter, &widget->screen_location, sizeof(ei_rect_t)) == 0;
+}
+
+// Géométrie d'un widget relative au coin du content_rect de son parent.
+static ei_rect_t solve_layout(const ei_impl_placer_params_t* params, ei_size_t parent_size, ei_size_t requested_size) {
     // Compute position
-    int pos_x = params->x + (int)(params->rel_x * parent_rect.size.width);
-    int pos_y = params->y + (int)(params->rel_y * parent_rect.size.height);
+    int pos_x = params->x + (int)(params->rel_x * parent_size.width);
+    int pos_y = params->y + (int)(params->rel_y * parent_size.height);
 
     // Compute size
     int final_width, final_height;
-    // ... (le reste du calcul de final_width et final_height reste inchangé) ...
     if (params->rel_width > 0.0f) {
-        final_width = (int)(params->rel_width * parent_rect.size.width);
+        final_width = (int)(params->rel_width * parent_size.width);
     } else if (params->width > 0) {
         final_width = params->width;
     } else {
-        final_width = impl_widget->requested_size.width;
+        final_width = requested_size.width;
         // Si requested_size est aussi 0, la taille par défaut de la classe devrait déjà
         // être dans requested_size via setdefaultsfunc.
         // Si elle est toujours 0, c'est que le widget n'a pas de taille intrinsèque (ex: frame vide sans bordure).
     }
 
     if (params->rel_height > 0.0f) {
-        final_height = (int)(params->rel_height * parent_rect.size.height);
+        final_height = (int)(params->rel_height * parent_size.height);
     } else if (params->height > 0) {
         final_height = params->height;
     } else {
-        final_height = impl_widget->requested_size.height;
+        final_height = requested_size.height;
     }
 
 
     // Adjust position based on anchor
-    // ... (le switch pour l'ancre reste inchangé) ...
     switch (params->anchor) {
         case ei_anc_center:
             pos_x -= final_width / 2;
@@ -95,12 +192,53 @@ void ei_impl_placer_run(ei_widget_t widget) {
             break;
     }
 
+    return ei_rect(ei_point(pos_x, pos_y), ei_size(final_width, final_height));
+}
+
+// Dans ei_placer.c
+void ei_impl_placer_run(ei_widget_t widget) {
+    ei_impl_widget_t* impl_widget = (ei_impl_widget_t*)widget;
+    assert(impl_widget->placer_params != NULL && "hmm , pas de placer_params");
+
+    // Dans une transaction, le placement attend le commit (une seule fois par widget)
+    if (g_layout_depth > 0 && !g_layout_flushing && layout_enqueue(widget)) {
+        return;
+    }
+    layout_dequeue(widget);
+
+    ei_impl_placer_params_t* params = impl_widget->placer_params;
+
+    // Stocker l'ancienne position pour invalidation
+    ei_rect_t old_screen_location = impl_widget->screen_location;
+
+    // Get parent’s content_rect (or root surface size for root widget)
+    ei_rect_t parent_rect;
+    if (impl_widget->parent != NULL) {
+        parent_rect = *(((ei_impl_widget_t*)impl_widget->parent)->content_rect);
+    } else {
+        // Root widget: use the size of the root surface
+        ei_size_t surface_size = hw_surface_get_size(ei_app_root_surface());
+        parent_rect.top_left = (ei_point_t){0, 0};
+        parent_rect.size = surface_size;
+    }
+
+    // Ne refaire le calcul que si ses entrées ont changé : un parent qui n'a fait que se
+    // déplacer translate ses enfants
+    if (params->dirty ||
+        params->parent_size.width != parent_rect.size.width ||
+        params->parent_size.height != parent_rect.size.height ||
+        params->requested_size.width != impl_widget->requested_size.width ||
+        params->requested_size.height != impl_widget->requested_size.height) {
+        params->layout = solve_layout(params, parent_rect.size, impl_widget->requested_size);
+        params->parent_size = parent_rect.size;
+        params->requested_size = impl_widget->requested_size;
+        params->dirty = false;
+    }
 
     // Update screen_location
-    impl_widget->screen_location.top_left.x = parent_rect.top_left.x + pos_x;
-    impl_widget->screen_location.top_left.y = parent_rect.top_left.y + pos_y;
-    impl_widget->screen_location.size.width = final_width;
-    impl_widget->screen_location.size.height = final_height;
+    impl_widget->screen_location.top_left.x = parent_rect.top_left.x + params->layout.top_left.x;
+    impl_widget->screen_location.top_left.y = parent_rect.top_left.y + params->layout.top_left.y;
+    impl_widget->screen_location.size = params->layout.size;
 
     // **APPELER GEOMNOTIFYFUNC ICI**
     // Il est crucial que geomnotifyfunc soit appelé *après* que screen_location soit à jour,
@@ -113,19 +251,92 @@ void ei_impl_placer_run(ei_widget_t widget) {
     //     impl_widget->wclass->geomnotifyfunc(widget);
     //     impl_widget->geomnotify_in_progress = false;
     // }
+    ei_widget_t placing_parent = g_placing_widget;
+    int parent_followers = g_nb_followers;
+    g_placing_widget = widget;
+    g_nb_followers = 0;
     if (impl_widget->wclass && impl_widget->wclass->geomnotifyfunc) {
         impl_widget->wclass->geomnotifyfunc(widget);
     }
+    // Les enfants qui n'ont pas été replacés (pas de geomnotifyfunc) sont restés sur place
+    int nb_placed = 0;
+    for (ei_widget_t child = impl_widget->children_head; child != NULL; child = child->next_sibling) {
+        nb_placed += child->placer_params != NULL;
+    }
+    bool subtree_follows = g_nb_followers == nb_placed;
+    g_placing_widget = placing_parent;
+    g_nb_followers = parent_followers;
     // Si `geomnotifyfunc` a mis à jour la géométrie des enfants,
-    // ces enfants auront déjà été invalidés par leurs propres appels à `ei_impl_placer_run`.
+    // ces enfants auront déjà été invalidés par leurs propres appels à `ei_impl_placer_run`
+    // (sauf ceux qui ont suivi le widget, voir g_placing_widget).
+
+    ei_impl_widget_update_subtree_bounds(widget);
+
+    // Le cache du parent reste valable si le widget a suivi le parent sans changer de taille,
+    // ou si le widget est un calque, qui ne fait pas partie du cache de son parent
+    bool same_size = old_screen_location.size.width == impl_widget->screen_location.size.width &&
+                     old_screen_location.size.height == impl_widget->screen_location.size.height;
+    bool rigid = same_size &&
+                 old_screen_location.top_left.x - params->parent_origin.x == impl_widget->screen_location.top_left.x - parent_rect.top_left.x &&
+                 old_screen_location.top_left.y - params->parent_origin.y == impl_widget->screen_location.top_left.y - parent_rect.top_left.y;
+    bool moved = old_screen_location.top_left.x != impl_widget->screen_location.top_left.x ||
+                 old_screen_location.top_left.y != impl_widget->screen_location.top_left.y ||
+                 !same_size;
+    bool follows_parent = rigid && impl_widget->parent != NULL && impl_widget->parent == placing_parent;
+    params->parent_origin = parent_rect.top_left;
+    if (follows_parent && subtree_follows) {
+        g_nb_followers++;
+    }
+
+    if (!rigid && !impl_widget->layer) {
+        ei_impl_widget_cache_invalidate(impl_widget->parent);
+    }
+    if (moved && !subtree_follows) {
+        // Les enfants restés sur place ne sont plus au même endroit dans le rendu du widget,
+        // ni dans son index
+        ei_impl_widget_cache_invalidate(widget);
+        ei_impl_spatial_index_container_moved(widget);
+    }
+    if (follows_parent) {
+        // Les zones du parent (ancienne et nouvelle) couvrent déjà celles du widget
+        return;
+    }
 
     // Invalidate l'ancienne et la nouvelle position du widget
     // (si elles sont différentes et valides)
-    if (old_screen_location.size.width > 0 && old_screen_location.size.height > 0 &&
-        (old_screen_location.top_left.x != impl_widget->screen_location.top_left.x ||
-         old_screen_location.top_left.y != impl_widget->screen_location.top_left.y ||
-         old_screen_location.size.width != impl_widget->screen_location.size.width ||
-         old_screen_location.size.height != impl_widget->screen_location.size.height)) {
+    // Simple translation d'un widget opaque et entièrement visible : ses pixels sont copiés
+    // et seule la partie découverte de l'ancienne zone est redessinée
+    if (moved && same_size && subtree_follows && is_opaque(widget) &&
+        ei_impl_widget_is_unobscured(widget, &old_screen_location) &&
+        ei_impl_widget_is_unobscured(widget, &impl_widget->screen_location) &&
+        ei_impl_app_move_rect(&old_screen_location, impl_widget->screen_location.top_left)) {
+        return;
+    }
+    if (!moved) {
+        // Même position : seul le rendu peut avoir changé, les pick_id restent valides
+        if (impl_widget->screen_location.size.width > 0 && impl_widget->screen_location.size.height > 0) {
+            ei_impl_app_invalidate_paint(&impl_widget->screen_location);
+        }
+        return;
+    }
+
+    // Si le rendu du widget ne change pas là où ses deux positions se recouvrent, seule la
+    // différence symétrique est endommagée (deux fines bandes pour un déplacement d'un pixel)
+    int invariance = ei_impl_widget_invariance(widget);
+    bool same_corner = old_screen_location.top_left.x == impl_widget->screen_location.top_left.x &&
+                       old_screen_location.top_left.y == impl_widget->screen_location.top_left.y;
+    if ((same_size && (invariance & ei_impl_invariant_translation)) ||
+        (same_corner && (invariance & ei_impl_invariant_resize))) {
+        ei_rect_t damage[8];
+        int nb_damage = subtract_rect(damage, &impl_widget->screen_location, &old_screen_location);
+        nb_damage += subtract_rect(&damage[nb_damage], &old_screen_location, &impl_widget->screen_location);
+        ei_impl_app_invalidate_region(damage, nb_damage, true);
+        return;
+    }
+
+    // Sinon, les deux positions entières (fusionnées par ei_app_invalidate_rect si elles se touchent :
+    // un seul parcours de l'arbre vaut mieux que plusieurs bandes pour quelques pixels de coins)
+    if (old_screen_location.size.width > 0 && old_screen_location.size.height > 0) {
         ei_app_invalidate_rect(&old_screen_location);
     }
     if (impl_widget->screen_location.size.width > 0 && impl_widget->screen_location.size.height > 0) {
@@ -153,7 +364,9 @@ void ei_place(ei_widget_t widget, ei_anchor_t* anchor, int* x, int* y, int* widt
         impl_widget->placer_params->rel_y = 0.0f;
         impl_widget->placer_params->rel_width = 0.0f;
         impl_widget->placer_params->rel_height = 0.0f;
+        impl_widget->placer_params->parent_origin = ei_point_zero();
     }
+    impl_widget->placer_params->dirty = true;
 
     ei_impl_placer_params_t* params = impl_widget->placer_params;
 
@@ -180,8 +393,11 @@ void ei_placer_forget(ei_widget_t widget) {
 
     // Invalidate the current screen_location to clear the widget
     ei_app_invalidate_rect(&impl_widget->screen_location);
+    ei_impl_widget_cache_invalidate(impl_widget->parent);
 
     // Free placer_params and reset
+    ei_animate_cancel(widget);
+    layout_dequeue(widget);
     if (impl_widget->placer_params != NULL) {
         free(impl_widget->placer_params);
         impl_widget->placer_params = NULL;
@@ -193,5 +409,6 @@ void ei_placer_forget(ei_widget_t widget) {
         free(impl_widget->content_rect);
         impl_widget->content_rect = &impl_widget->screen_location;
     }
+    ei_impl_widget_update_subtree_bounds(widget);
 }
 
@@ -0,0 +1,184 @@
+#include "ei_present_filter.h"
+#include "ei_implementation.h"
+#include "ei_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PRIME64_1   0x9E3779B185EBCA87ULL
+#define PRIME64_2   0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3   0x165667B19E3779F9ULL
+
+typedef struct {
+    uint64_t hash;          // Hash de la tuile telle que présentée
+    uint32_t stamp;         // Dernier filtrage où la tuile était dans la liste de mise à jour
+    bool     known;         // false : contenu présenté inconnu, la tuile doit être présentée
+    bool     changed;       // Résultat du filtrage "stamp"
+} tile_t;
+
+static bool              g_enabled   = false;
+static tile_t*           g_tiles     = NULL;
+static int               g_nb_cols   = 0;
+static int               g_nb_rows   = 0;
+static uint32_t          g_stamp     = 0;
+static ei_linked_rect_t* g_out       = NULL;   // Liste filtrée, dans un tableau réutilisé
+static int               g_out_size  = 0;
+static int               g_nb_out    = 0;
+
+
+void ei_impl_present_filter_enable(bool enabled) {
+    g_enabled = enabled;
+    if (!enabled) {
+        ei_impl_present_filter_release();
+    }
+}
+
+bool ei_impl_present_filter_enabled(void) {
+    return g_enabled;
+}
+
+void ei_impl_present_filter_reset(void) {
+    for (int i = 0; i < g_nb_cols * g_nb_rows; i++) {
+        g_tiles[i].known = false;
+    }
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Hash d'une tuile, à la manière de xxhash64 : un accumulateur par mot de 64 bits, puis un mélange final.
+static uint64_t hash_tile(const uint32_t* pixels, int stride, const ei_rect_t* tile) {
+    uint64_t acc = PRIME64_3 ^ ((uint64_t)tile->size.width << 32 | (uint32_t)tile->size.height);
+    for (int y = 0; y < tile->size.height; y++) {
+        const uint32_t* row = pixels + (size_t)(tile->top_left.y + y) * stride + tile->top_left.x;
+        int x = 0;
+        for (; x + 2 <= tile->size.width; x += 2) {
+            uint64_t word;
+            memcpy(&word, row + x, sizeof(word));
+            acc = rotl64(acc + word * PRIME64_2, 31) * PRIME64_1;
+        }
+        if (x < tile->size.width) {
+            acc = rotl64(acc + row[x] * PRIME64_2, 31) * PRIME64_1;
+        }
+    }
+    acc ^= acc >> 33;
+    acc *= PRIME64_2;
+    acc ^= acc >> 29;
+    acc *= PRIME64_3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+static bool ensure_tiles(ei_size_t size) {
+    int nb_cols = (size.width + EI_PRESENT_TILE_SIZE - 1) / EI_PRESENT_TILE_SIZE;
+    int nb_rows = (size.height + EI_PRESENT_TILE_SIZE - 1) / EI_PRESENT_TILE_SIZE;
+    if (g_tiles != NULL && nb_cols == g_nb_cols && nb_rows == g_nb_rows) {
+        return true;
+    }
+    free(g_tiles);
+    g_tiles = calloc((size_t)nb_cols * nb_rows, sizeof(tile_t));
+    if (g_tiles == NULL) {
+        g_nb_cols = g_nb_rows = 0;
+        return false;
+    }
+    g_nb_cols = nb_cols;
+    g_nb_rows = nb_rows;
+    return true;
+}
+
+static bool push_out(const ei_rect_t* rect) {
+    if (g_nb_out == g_out_size) {
+        int size = g_out_size == 0 ? 64 : 2 * g_out_size;
+        ei_linked_rect_t* out = realloc(g_out, size * sizeof(ei_linked_rect_t));
+        if (out == NULL) {
+            return false;
+        }
+        g_out = out;
+        g_out_size = size;
+    }
+    g_out[g_nb_out].rect = *rect;
+    g_out[g_nb_out].next = NULL;
+    g_nb_out++;
+    return true;
+}
+
+// Limites en tuiles (colonnes et lignes, bornes exclues) d'un rectangle déjà restreint à la surface.
+static void tile_span(const ei_rect_t* rect, int* col_min, int* col_max, int* row_min, int* row_max) {
+    *col_min = rect->top_left.x / EI_PRESENT_TILE_SIZE;
+    *row_min = rect->top_left.y / EI_PRESENT_TILE_SIZE;
+    *col_max = (rect->top_left.x + rect->size.width + EI_PRESENT_TILE_SIZE - 1) / EI_PRESENT_TILE_SIZE;
+    *row_max = (rect->top_left.y + rect->size.height + EI_PRESENT_TILE_SIZE - 1) / EI_PRESENT_TILE_SIZE;
+}
+
+const ei_linked_rect_t* ei_impl_present_filter_run(ei_surface_t surface, const ei_linked_rect_t* rects,
+                                                   uint64_t* bytes_saved) {
+    ei_size_t size = hw_surface_get_size(surface);
+    if (!ensure_tiles(size)) {
+        return rects;
+    }
+    ei_rect_t surface_rect = ei_rect(ei_point_zero(), size);
+    const uint32_t* pixels = (const uint32_t*)hw_surface_get_buffer(surface);
+    g_stamp++;
+    g_nb_out = 0;
+
+    for (const ei_linked_rect_t* link = rects; link != NULL; link = link->next) {
+        ei_rect_t rect;
+        if (!intersection_rect(&rect, &link->rect, &surface_rect)) {
+            continue;
+        }
+        int col_min, col_max, row_min, row_max;
+        tile_span(&rect, &col_min, &col_max, &row_min, &row_max);
+        for (int row = row_min; row < row_max; row++) {
+            // Les morceaux présentés d'une même ligne de tuiles sont fusionnés quand ils se suivent
+            ei_rect_t run = ei_rect_zero();
+            for (int col = col_min; col < col_max; col++) {
+                tile_t* tile = &g_tiles[row * g_nb_cols + col];
+                ei_rect_t tile_rect = ei_rect(ei_point(col * EI_PRESENT_TILE_SIZE, row * EI_PRESENT_TILE_SIZE),
+                                              ei_size(EI_PRESENT_TILE_SIZE, EI_PRESENT_TILE_SIZE));
+                intersection_rect(&tile_rect, &tile_rect, &surface_rect);
+                if (tile->stamp != g_stamp) {
+                    uint64_t hash = hash_tile(pixels, size.width, &tile_rect);
+                    tile->changed = !tile->known || tile->hash != hash;
+                    tile->hash = hash;
+                    tile->known = true;
+                    tile->stamp = g_stamp;
+                }
+
+                ei_rect_t piece;
+                intersection_rect(&piece, &tile_rect, &rect);
+                if (!tile->changed) {
+                    *bytes_saved += (uint64_t)piece.size.width * piece.size.height * sizeof(uint32_t);
+                    continue;
+                }
+                if (run.size.width > 0 && run.top_left.x + run.size.width == piece.top_left.x) {
+                    run.size.width += piece.size.width;
+                    continue;
+                }
+                if (run.size.width > 0 && !push_out(&run)) {
+                    return rects;
+                }
+                run = piece;
+            }
+            if (run.size.width > 0 && !push_out(&run)) {
+                return rects;
+            }
+        }
+    }
+
+    if (g_nb_out == 0) {
+        return NULL;
+    }
+    for (int i = 0; i + 1 < g_nb_out; i++) {
+        g_out[i].next = &g_out[i + 1];
+    }
+    return g_out;
+}
+
+void ei_impl_present_filter_release(void) {
+    free(g_tiles);
+    g_tiles = NULL;
+    g_nb_cols = g_nb_rows = 0;
+    free(g_out);
+    g_out = NULL;
+    g_out_size = g_nb_out = 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file  ei_present_filter.h
+ *
+ * @brief Present-stage filter (see \ref ei_app_set_present_filter): after a redraw, every
+ *        tile of the root surface touched by the update list is hashed and compared with the
+ *        hash of the tile as it was last presented. The parts of the update list that fall
+ *        in unchanged tiles are not sent to \ref hw_surface_update_rects.
+ *
+ *        The screen is assumed to show the root surface everywhere once a redraw is presented:
+ *        the hashes are forgotten when this is not true anymore (exposed window).
+ *
+ */
+
+#ifndef EI_PRESENT_FILTER_H
+#define EI_PRESENT_FILTER_H
+
+#include "ei_types.h"
+#include "hw_interface.h"
+#include <stdint.h>
+
+/**
+ * \brief	Side of the square tiles that are hashed, in pixels.
+ */
+#ifndef EI_PRESENT_TILE_SIZE
+#define EI_PRESENT_TILE_SIZE	64
+#endif
+
+/**
+ * \brief	Enables or disables the filter. Disabling it frees the tile hashes.
+ */
+void ei_impl_present_filter_enable(bool enabled);
+
+/**
+ * \brief	Returns true if the filter is enabled.
+ */
+bool ei_impl_present_filter_enabled(void);
+
+/**
+ * \brief	Forgets the presented hashes: the next update list is presented entirely.
+ */
+void ei_impl_present_filter_reset(void);
+
+/**
+ * \brief	Filters an update list. Must be called on the *locked* root surface, after drawing.
+ *
+ * @param	surface		The root surface.
+ * @param	rects		The update list, may contain overlapping rectangles.
+ * @param	bytes_saved	Incremented by the size of the pixels that are not presented.
+ *
+ * @return			The filtered update list, owned by the filter and valid until the next
+ *				call. NULL if nothing changed on screen: \ref hw_surface_update_rects
+ *				must then not be called (NULL means the whole surface).
+ */
+const ei_linked_rect_t* ei_impl_present_filter_run(ei_surface_t surface, const ei_linked_rect_t* rects,
+						   uint64_t* bytes_saved);
+
+/**
+ * \brief	Frees the memory of the filter. Called by \ref ei_app_free.
+ */
+void ei_impl_present_filter_release(void);
+
+#endif
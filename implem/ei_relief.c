@@ -132,6 +132,18 @@ void draw_button(ei_surface_t surface,
     assert(rayon >= 0.0f && "draw_button: rayon cannot be negative");
     assert(epaisseur_relief >= 0 && "draw_button: epaisseur_relief cannot be negative");
 
+    // En qualité réduite (manipulation en cours) : un simple rectangle, sans coins ni relief
+    if (ei_impl_app_low_quality()) {
+        ei_rect_t flat;
+        if (clipper_externe == NULL) {
+            flat = *rect;
+        } else if (!intersection_rect(&flat, rect, clipper_externe)) {
+            return;
+        }
+        ei_fill(surface, &color_centre, &flat);
+        return;
+    }
+
     // S'assurer que le rayon n'est pas trop grand pour le rectangle extérieur
     float rayon_exterieur = rayon;
     if (rayon_exterieur > (float)rect->size.width / 2.0f) rayon_exterieur = (float)rect->size.width / 2.0f;
@@ -0,0 +1,286 @@
+#include "ei_spatial_index.h"
+#include "ei_implementation.h"
+#include "ei_utils.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EI_SPATIAL_INDEX_MIN_CELL       16  // Côté minimum d'une cellule, en pixels
+#define EI_SPATIAL_INDEX_PER_CELL       2   // Nombre moyen d'enfants visé par cellule
+
+typedef struct {
+    ei_widget_t* children;
+    int          nb;
+    int          capacity;
+} grid_cell_t;
+
+struct ei_impl_spatial_index_t {
+    ei_rect_t    area;          ///< content_rect du conteneur : taille lors de la construction, coin actuel.
+    int          cell_size;
+    int          nb_cols;
+    int          nb_rows;
+    grid_cell_t* cells;         ///< nb_cols * nb_rows cellules, ligne par ligne.
+    int          built_for;     ///< Nombre d'enfants lors de la construction.
+    uint32_t     stamp;         ///< Incrémenté à chaque requête (voir index_stamp des widgets).
+};
+
+
+static bool rect_is_empty(const ei_rect_t* rect) {
+    return rect->size.width <= 0 || rect->size.height <= 0;
+}
+
+static int clamp_int(int value, int low, int high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+// Rectangle relatif au coin du conteneur : les cellules et les indexed_bounds des enfants ne
+// changent pas quand le conteneur est translaté avec ses enfants.
+static ei_rect_t to_grid(const ei_impl_spatial_index_t* index, const ei_rect_t* rect) {
+    return ei_rect(ei_point_sub(rect->top_left, index->area.top_left), rect->size);
+}
+
+// Plage de cellules couverte par un rectangle relatif au conteneur. Les parties hors de la zone de
+// la grille sont ramenées sur les cellules du bord : un enfant qui déborde reste toujours trouvable.
+static bool cell_range(const ei_impl_spatial_index_t* index, const ei_rect_t* rect,
+                       int* col_min, int* row_min, int* col_max, int* row_max) {
+    if (rect_is_empty(rect)) {
+        return false;
+    }
+    int x0 = rect->top_left.x;
+    int y0 = rect->top_left.y;
+    int x1 = x0 + rect->size.width - 1;
+    int y1 = y0 + rect->size.height - 1;
+
+    *col_min = clamp_int(x0 < 0 ? -1 : x0 / index->cell_size, 0, index->nb_cols - 1);
+    *row_min = clamp_int(y0 < 0 ? -1 : y0 / index->cell_size, 0, index->nb_rows - 1);
+    *col_max = clamp_int(x1 < 0 ? -1 : x1 / index->cell_size, 0, index->nb_cols - 1);
+    *row_max = clamp_int(y1 < 0 ? -1 : y1 / index->cell_size, 0, index->nb_rows - 1);
+    return true;
+}
+
+static void cell_push(grid_cell_t* cell, ei_widget_t child) {
+    if (cell->nb == cell->capacity) {
+        cell->capacity = cell->capacity == 0 ? 4 : 2 * cell->capacity;
+        cell->children = realloc(cell->children, cell->capacity * sizeof(ei_widget_t));
+        assert(cell->children != NULL && "Failed to grow spatial index cell");
+    }
+    cell->children[cell->nb++] = child;
+}
+
+static void cell_remove(grid_cell_t* cell, ei_widget_t child) {
+    for (int i = 0; i < cell->nb; i++) {
+        if (cell->children[i] == child) {
+            cell->children[i] = cell->children[--cell->nb];
+            return;
+        }
+    }
+}
+
+static void index_insert(ei_impl_spatial_index_t* index, ei_widget_t child) {
+    child->indexed_bounds = to_grid(index, &child->subtree_bounds);
+    int c0, r0, c1, r1;
+    if (!cell_range(index, &child->indexed_bounds, &c0, &r0, &c1, &r1)) {
+        return;
+    }
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            cell_push(&index->cells[r * index->nb_cols + c], child);
+        }
+    }
+}
+
+static void index_remove(ei_impl_spatial_index_t* index, ei_widget_t child) {
+    int c0, r0, c1, r1;
+    if (cell_range(index, &child->indexed_bounds, &c0, &r0, &c1, &r1)) {
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) {
+                cell_remove(&index->cells[r * index->nb_cols + c], child);
+            }
+        }
+    }
+    child->indexed_bounds = ei_rect_zero();
+}
+
+static void index_release_cells(ei_impl_spatial_index_t* index) {
+    for (int i = 0; i < index->nb_cols * index->nb_rows; i++) {
+        free(index->cells[i].children);
+    }
+    free(index->cells);
+    index->cells = NULL;
+}
+
+// (Re)construit la grille sur le content_rect courant du conteneur, dimensionnée pour son nombre d'enfants.
+static void index_build(ei_widget_t container) {
+    ei_impl_spatial_index_t* index = container->spatial_index;
+    if (index->cells != NULL) {
+        index_release_cells(index);
+    }
+
+    index->area = *container->content_rect;
+    if (rect_is_empty(&index->area)) {
+        index->area = ei_rect(index->area.top_left, ei_size(1, 1));
+    }
+    index->built_for = container->nb_children;
+
+    double cell_area = (double)index->area.size.width * index->area.size.height * EI_SPATIAL_INDEX_PER_CELL
+                       / (container->nb_children > 0 ? container->nb_children : 1);
+    index->cell_size = (int)ceil(sqrt(cell_area));
+    if (index->cell_size < EI_SPATIAL_INDEX_MIN_CELL) {
+        index->cell_size = EI_SPATIAL_INDEX_MIN_CELL;
+    }
+    index->nb_cols = (index->area.size.width + index->cell_size - 1) / index->cell_size;
+    index->nb_rows = (index->area.size.height + index->cell_size - 1) / index->cell_size;
+
+    index->cells = calloc((size_t)index->nb_cols * index->nb_rows, sizeof(grid_cell_t));
+    assert(index->cells != NULL && "Failed to allocate spatial index");
+
+    for (ei_widget_t child = container->children_head; child != NULL; child = child->next_sibling) {
+        index_insert(index, child);
+    }
+}
+
+// Suit le content_rect du conteneur : une translation ne touche pas aux cellules, seul un
+// changement de taille reconstruit la grille.
+static void index_follow(ei_widget_t container) {
+    ei_impl_spatial_index_t* index = container->spatial_index;
+    const ei_rect_t* area = container->content_rect;
+    if (rect_is_empty(area)) {
+        return;
+    }
+    if (area->size.width != index->area.size.width || area->size.height != index->area.size.height) {
+        index_build(container);
+    } else {
+        index->area.top_left = area->top_left;
+    }
+}
+
+// Change de cellules un enfant dont la position relative au conteneur a changé.
+static void index_update(ei_impl_spatial_index_t* index, ei_widget_t child) {
+    ei_rect_t bounds = to_grid(index, &child->subtree_bounds);
+    if (memcmp(&child->indexed_bounds, &bounds, sizeof(ei_rect_t)) == 0) {
+        return;
+    }
+    index_remove(index, child);
+    index_insert(index, child);
+}
+
+void ei_impl_spatial_index_child_added(ei_widget_t container) {
+    assert(container != NULL);
+    container->nb_children++;
+
+    if (container->spatial_index == NULL) {
+        if (container->nb_children > EI_SPATIAL_INDEX_THRESHOLD) {
+            container->spatial_index = calloc(1, sizeof(ei_impl_spatial_index_t));
+            assert(container->spatial_index != NULL && "Failed to allocate spatial index");
+            index_build(container);
+        }
+    } else if (container->nb_children >= 2 * container->spatial_index->built_for) {
+        // Les cellules se remplissent : on redimensionne la grille (coût amorti constant par enfant)
+        index_build(container);
+    }
+}
+
+void ei_impl_spatial_index_child_removed(ei_widget_t container, ei_widget_t child) {
+    assert(container != NULL && child != NULL);
+    container->nb_children--;
+
+    if (container->spatial_index == NULL) {
+        return;
+    }
+    if (container->nb_children < EI_SPATIAL_INDEX_THRESHOLD / 2) {
+        ei_impl_spatial_index_free(container);
+        return;
+    }
+    index_remove(container->spatial_index, child);
+}
+
+void ei_impl_spatial_index_child_moved(ei_widget_t child) {
+    assert(child != NULL);
+    ei_widget_t container = child->parent;
+    if (container == NULL || container->spatial_index == NULL) {
+        return;
+    }
+    index_follow(container);
+    index_update(container->spatial_index, child);
+}
+
+void ei_impl_spatial_index_container_moved(ei_widget_t container) {
+    assert(container != NULL);
+    if (container->spatial_index == NULL) {
+        return;
+    }
+    index_follow(container);
+    for (ei_widget_t child = container->children_head; child != NULL; child = child->next_sibling) {
+        index_update(container->spatial_index, child);
+    }
+}
+
+static int compare_z_order(const void* a, const void* b) {
+    uint32_t za = (*(const ei_widget_t*)a)->z_order;
+    uint32_t zb = (*(const ei_widget_t*)b)->z_order;
+    return (za > zb) - (za < zb);
+}
+
+size_t ei_impl_spatial_index_query(ei_widget_t container, const ei_rect_t* rect,
+                                   ei_widget_t** result, size_t* capacity) {
+    assert(container != NULL && container->spatial_index != NULL);
+    ei_impl_spatial_index_t* index = container->spatial_index;
+
+    // Le conteneur a bougé (ses enfants avec lui) ou changé de taille
+    index_follow(container);
+
+    int c0, r0, c1, r1;
+    ei_rect_t grid_rect = to_grid(index, rect);
+    if (!cell_range(index, &grid_rect, &c0, &r0, &c1, &r1)) {
+        return 0;
+    }
+
+    if (++index->stamp == 0) {
+        for (ei_widget_t child = container->children_head; child != NULL; child = child->next_sibling) {
+            child->index_stamp = 0;
+        }
+        index->stamp = 1;
+    }
+
+    size_t nb = 0;
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            grid_cell_t* cell = &index->cells[r * index->nb_cols + c];
+            for (int i = 0; i < cell->nb; i++) {
+                ei_widget_t child = cell->children[i];
+                ei_rect_t intersection;
+                if (child->index_stamp == index->stamp ||
+                    !intersection_rect(&intersection, &child->subtree_bounds, rect)) {
+                    continue;
+                }
+                child->index_stamp = index->stamp;
+                if (nb == *capacity) {
+                    *capacity = *capacity == 0 ? 64 : 2 * *capacity;
+                    *result = realloc(*result, *capacity * sizeof(ei_widget_t));
+                    assert(*result != NULL && "Failed to grow query result");
+                }
+                (*result)[nb++] = child;
+            }
+        }
+    }
+
+    if (nb > 1) {
+        qsort(*result, nb, sizeof(ei_widget_t), compare_z_order);
+    }
+    return nb;
+}
+
+void ei_impl_spatial_index_free(ei_widget_t container) {
+    assert(container != NULL);
+    ei_impl_spatial_index_t* index = container->spatial_index;
+    if (index == NULL) {
+        return;
+    }
+    index_release_cells(index);
+    free(index);
+    container->spatial_index = NULL;
+    for (ei_widget_t child = container->children_head; child != NULL; child = child->next_sibling) {
+        child->indexed_bounds = ei_rect_zero();
+    }
+}
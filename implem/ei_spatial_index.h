@@ -0,0 +1,84 @@
+/**
+ * @file  ei_spatial_index.h
+ *
+ * @brief Uniform grid over the children of a container, used to enumerate the children
+ *        that intersect a rectangle without scanning all of them.
+ *        The index is created automatically when a container holds more than
+ *        \ref EI_SPATIAL_INDEX_THRESHOLD children, and dropped when it falls well below.
+ *
+ */
+
+#ifndef EI_SPATIAL_INDEX_H
+#define EI_SPATIAL_INDEX_H
+
+#include "ei_types.h"
+#include <stddef.h>
+
+/**
+ * \brief	Number of children above which a container is indexed.
+ */
+#ifndef EI_SPATIAL_INDEX_THRESHOLD
+#define EI_SPATIAL_INDEX_THRESHOLD	64
+#endif
+
+/**
+ * \brief	Opaque grid structure, owned by the container (field spatial_index).
+ */
+typedef struct ei_impl_spatial_index_t ei_impl_spatial_index_t;
+
+/**
+ * \brief	Must be called after a child has been appended to a container: counts it in
+ *		nb_children and builds the index when the container crosses the threshold.
+ *
+ * @param	container	The parent of the new child.
+ */
+void ei_impl_spatial_index_child_added(ei_widget_t container);
+
+/**
+ * \brief	Must be called when a child is unlinked from its container, before it is freed:
+ *		uncounts it and drops the index when the container has become small.
+ *
+ * @param	container	The parent of the child.
+ * @param	child		The child being removed.
+ */
+void ei_impl_spatial_index_child_removed(ei_widget_t container, ei_widget_t child);
+
+/**
+ * \brief	Must be called when the subtree_bounds of a widget have changed.
+ *		Moves the widget in its parent's index, if the parent is indexed.
+ *
+ * @param	child		The widget whose bounds changed.
+ */
+void ei_impl_spatial_index_child_moved(ei_widget_t child);
+
+/**
+ * \brief	Must be called when the content_rect of a container has moved while some of its
+ *		children stayed in place. The index follows a translation of the container on its
+ *		own, assuming that its children follow it too (see \ref ei_impl_placer_run).
+ *
+ * @param	container	The container.
+ */
+void ei_impl_spatial_index_container_moved(ei_widget_t container);
+
+/**
+ * \brief	Enumerates the children of an indexed container whose subtree_bounds intersect a rectangle.
+ *
+ * @param	container	The container, its spatial_index must not be NULL.
+ * @param	rect		The rectangle, in screen coordinates.
+ * @param	result		In/out: a buffer allocated with malloc (may be NULL), grown with realloc if needed.
+ * @param	capacity	In/out: the number of entries of *result.
+ *
+ * @return			The number of children written in *result, sorted by increasing z_order
+ *				(drawing order).
+ */
+size_t ei_impl_spatial_index_query(ei_widget_t container, const ei_rect_t* rect,
+                                   ei_widget_t** result, size_t* capacity);
+
+/**
+ * \brief	Frees the index of a container, if any.
+ *
+ * @param	container	The container.
+ */
+void ei_impl_spatial_index_free(ei_widget_t container);
+
+#endif
@@ -0,0 +1,362 @@
+#include "ei_timer.h"
+#include "ei_implementation.h"
+#include "hw_interface.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/*
+ * Roue temporelle hiérarchique : EI_TIMER_NB_LEVELS niveaux de 64 créneaux, à la milliseconde.
+ * Le créneau d'un timer au niveau L couvre 64^L millisecondes. Quand le temps courant atteint le
+ * début d'un créneau de niveau L > 0, ses timers descendent d'un ou plusieurs niveaux ; au
+ * niveau 0, ils expirent. Un bitmap par niveau indique les créneaux occupés, ce qui donne la
+ * date du prochain réveil sans parcourir les créneaux.
+ */
+
+#define EI_TIMER_LEVEL_BITS     6
+#define EI_TIMER_NB_SLOTS       (1 << EI_TIMER_LEVEL_BITS)
+#define EI_TIMER_NB_LEVELS      4
+#define EI_TIMER_RANGE          ((uint64_t)1 << (EI_TIMER_LEVEL_BITS * EI_TIMER_NB_LEVELS))
+
+struct ei_impl_timer_t {
+    uint64_t                expiry;         // En millisecondes depuis g_origin
+    int                     period;         // 0 : timer unique
+    ei_timer_callback_t     callback;
+    ei_user_param_t         user_param;
+    ei_widget_t             owner;
+    bool                    cancelled;      // Annulé pendant son propre callback
+    struct ei_impl_timer_t* prev;           // Liste circulaire du créneau (ou de la liste en cours d'expiration)
+    struct ei_impl_timer_t* next;
+    struct ei_impl_timer_t* owner_prev;     // Timers du même propriétaire
+    struct ei_impl_timer_t* owner_next;
+};
+
+static struct ei_impl_timer_t g_slots[EI_TIMER_NB_LEVELS][EI_TIMER_NB_SLOTS]; // Sentinelles
+static uint64_t     g_occupied[EI_TIMER_NB_LEVELS];
+static bool         g_initialized   = false;
+static double       g_origin        = 0;    // hw_now() du temps 0
+static uint64_t     g_current       = 0;    // Tous les timers d'expiration <= g_current ont expiré
+static int          g_nb_timers     = 0;
+static int          g_tolerance     = 0;
+static ei_timer_t   g_firing        = NULL; // Timer dont le callback est en cours
+static void*        g_hw_timer      = NULL; // Le réveil matériel en attente, au plus un
+static uint64_t     g_hw_expiry     = 0;
+static int          g_stale_ticks   = 0;    // Réveils annulés trop tard, déjà dans la file d'événements
+static char         g_tick_marker;          // Son adresse sert de user_param au réveil
+
+
+static void list_init(ei_timer_t sentinel) {
+    sentinel->prev = sentinel->next = sentinel;
+}
+
+static bool list_empty(ei_timer_t sentinel) {
+    return sentinel->next == sentinel;
+}
+
+static void list_unlink(ei_timer_t timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = timer;
+}
+
+static void list_append(ei_timer_t sentinel, ei_timer_t timer) {
+    timer->prev = sentinel->prev;
+    timer->next = sentinel;
+    sentinel->prev->next = timer;
+    sentinel->prev = timer;
+}
+
+static void init(void) {
+    if (g_initialized) {
+        return;
+    }
+    for (int level = 0; level < EI_TIMER_NB_LEVELS; level++) {
+        for (int slot = 0; slot < EI_TIMER_NB_SLOTS; slot++) {
+            list_init(&g_slots[level][slot]);
+        }
+        g_occupied[level] = 0;
+    }
+    g_origin = hw_now();
+    g_current = 0;
+    g_initialized = true;
+}
+
+static uint64_t now_ms(void) {
+    double elapsed = hw_now() - g_origin;
+    return elapsed > 0 ? (uint64_t)(elapsed * 1000) : 0;
+}
+
+// Range un timer dans le créneau qui correspond à son expiration, relativement à g_current.
+static void wheel_insert(ei_timer_t timer) {
+    if (timer->expiry <= g_current) {
+        timer->expiry = g_current + 1;
+    }
+    uint64_t expiry = timer->expiry;
+    if (expiry - g_current >= EI_TIMER_RANGE) {
+        // Hors de portée : rangé au plus loin, il sera reclassé en descendant
+        expiry = g_current + EI_TIMER_RANGE - 1;
+    }
+    uint64_t delta = expiry - g_current;
+    int level = 0;
+    while (level < EI_TIMER_NB_LEVELS - 1 && delta >= ((uint64_t)1 << (EI_TIMER_LEVEL_BITS * (level + 1)))) {
+        level++;
+    }
+    int slot = (int)((expiry >> (EI_TIMER_LEVEL_BITS * level)) & (EI_TIMER_NB_SLOTS - 1));
+    list_append(&g_slots[level][slot], timer);
+    g_occupied[level] |= (uint64_t)1 << slot;
+}
+
+static void wheel_remove(ei_timer_t timer) {
+    ei_timer_t next = timer->next;
+    list_unlink(timer);
+    // Si le timer était le dernier de son créneau, next est la sentinelle : libérer le bit
+    for (int level = 0; level < EI_TIMER_NB_LEVELS; level++) {
+        if (next >= &g_slots[level][0] && next < &g_slots[level][EI_TIMER_NB_SLOTS]) {
+            if (list_empty(next)) {
+                g_occupied[level] &= ~((uint64_t)1 << (next - &g_slots[level][0]));
+            }
+            return;
+        }
+    }
+}
+
+// Date (en millisecondes) à laquelle la roue doit avancer pour traiter le prochain créneau
+// occupé d'un niveau : expiration au niveau 0, descente des timers aux niveaux supérieurs.
+static bool level_next_tick(int level, uint64_t* tick) {
+    uint64_t bits = g_occupied[level];
+    if (bits == 0) {
+        return false;
+    }
+    int shift = EI_TIMER_LEVEL_BITS * level;
+    uint64_t current = g_current >> shift;
+    int slot = (int)(current & (EI_TIMER_NB_SLOTS - 1));
+    uint64_t round = current - slot;
+    uint64_t after = slot == EI_TIMER_NB_SLOTS - 1 ? 0 : bits & (~(uint64_t)0 << (slot + 1));
+    if (after != 0) {
+        *tick = (round + __builtin_ctzll(after)) << shift;
+    } else {
+        // Les créneaux avant le créneau courant appartiennent au tour suivant
+        *tick = (round + EI_TIMER_NB_SLOTS + __builtin_ctzll(bits)) << shift;
+    }
+    return true;
+}
+
+static void cascade(int level) {
+    int shift = EI_TIMER_LEVEL_BITS * level;
+    int slot = (int)((g_current >> shift) & (EI_TIMER_NB_SLOTS - 1));
+    ei_timer_t sentinel = &g_slots[level][slot];
+    if (list_empty(sentinel)) {
+        return;
+    }
+    struct ei_impl_timer_t moving;
+    list_init(&moving);
+    // Déplacer toute la liste du créneau, puis reclasser chaque timer
+    moving.next = sentinel->next;
+    moving.prev = sentinel->prev;
+    moving.next->prev = &moving;
+    moving.prev->next = &moving;
+    list_init(sentinel);
+    g_occupied[level] &= ~((uint64_t)1 << slot);
+    while (!list_empty(&moving)) {
+        ei_timer_t timer = moving.next;
+        list_unlink(timer);
+        wheel_insert(timer);
+    }
+}
+
+static void owner_unlink(ei_timer_t timer) {
+    if (timer->owner == NULL) {
+        return;
+    }
+    if (timer->owner_prev != NULL) {
+        timer->owner_prev->owner_next = timer->owner_next;
+    } else {
+        timer->owner->timers = timer->owner_next;
+    }
+    if (timer->owner_next != NULL) {
+        timer->owner_next->owner_prev = timer->owner_prev;
+    }
+    timer->owner = NULL;
+    timer->owner_prev = timer->owner_next = NULL;
+}
+
+static uint64_t apply_tolerance(uint64_t expiry) {
+    if (g_tolerance <= 0) {
+        return expiry;
+    }
+    return (expiry + g_tolerance - 1) / g_tolerance * g_tolerance;
+}
+
+// Garde un seul réveil matériel, programmé pour le prochain créneau occupé.
+static void schedule_hw_timer(void) {
+    uint64_t next = 0;
+    bool found = false;
+    for (int level = 0; level < EI_TIMER_NB_LEVELS; level++) {
+        uint64_t tick;
+        if (level_next_tick(level, &tick) && (!found || tick < next)) {
+            next = tick;
+            found = true;
+        }
+    }
+    if (g_hw_timer != NULL && (!found || g_hw_expiry != next)) {
+        // Echec de l'annulation : le marqueur est déjà en file et arrivera avant le nouveau
+        if (!hw_event_cancel_app(g_hw_timer)) {
+            g_stale_ticks++;
+        }
+        g_hw_timer = NULL;
+    }
+    if (!found || g_hw_timer != NULL) {
+        return;
+    }
+    uint64_t now = now_ms();
+    int delay = next > now ? (int)(next - now) : 0;
+    g_hw_timer = hw_event_schedule_app(delay, &g_tick_marker);
+    g_hw_expiry = next;
+}
+
+ei_timer_t ei_timer_start(int delay_ms, int period_ms, ei_widget_t owner,
+                          ei_timer_callback_t callback, ei_user_param_t user_param) {
+    assert(callback != NULL);
+    init();
+    ei_timer_t timer = calloc(1, sizeof(struct ei_impl_timer_t));
+    assert(timer != NULL && "Failed to allocate a timer");
+    timer->period = period_ms > 0 ? period_ms : 0;
+    timer->callback = callback;
+    timer->user_param = user_param;
+    timer->expiry = apply_tolerance(now_ms() + (delay_ms > 0 ? delay_ms : 0));
+    list_init(timer);
+    wheel_insert(timer);
+    g_nb_timers++;
+
+    if (owner != NULL) {
+        timer->owner = owner;
+        timer->owner_next = owner->timers;
+        if (owner->timers != NULL) {
+            owner->timers->owner_prev = timer;
+        }
+        owner->timers = timer;
+    }
+
+    schedule_hw_timer();
+    return timer;
+}
+
+void ei_timer_cancel(ei_timer_t timer) {
+    if (timer == NULL || timer->cancelled) {
+        return;
+    }
+    owner_unlink(timer);
+    if (timer == g_firing) {
+        // Libéré au retour du callback
+        timer->cancelled = true;
+        return;
+    }
+    wheel_remove(timer);
+    free(timer);
+    g_nb_timers--;
+    schedule_hw_timer();
+}
+
+void ei_timer_cancel_owner(ei_widget_t owner) {
+    while (owner->timers != NULL) {
+        ei_timer_cancel(owner->timers);
+    }
+}
+
+void ei_timer_set_tolerance(int tolerance_ms) {
+    g_tolerance = tolerance_ms > 0 ? tolerance_ms : 0;
+}
+
+bool ei_impl_timer_is_tick(const ei_event_t* event) {
+    return event->type == ei_ev_app && event->param.application.user_param == &g_tick_marker;
+}
+
+// Appelle le callback d'un timer expiré, puis le reprogramme s'il est périodique.
+static void fire(ei_timer_t timer) {
+    g_firing = timer;
+    timer->callback(timer, timer->user_param);
+    g_firing = NULL;
+    if (timer->period > 0 && !timer->cancelled) {
+        // Pas de rattrapage après une longue attente : la période repart de maintenant
+        uint64_t expiry = timer->expiry + timer->period;
+        timer->expiry = apply_tolerance(expiry > g_current ? expiry : g_current + timer->period);
+        wheel_insert(timer);
+        return;
+    }
+    owner_unlink(timer);
+    free(timer);
+    g_nb_timers--;
+}
+
+void ei_impl_timer_run(void) {
+    if (!g_initialized) {
+        return;
+    }
+    // Un marqueur périmé ne libère pas le réveil en attente ; les timers échus sont traités quand même
+    if (g_stale_ticks > 0) {
+        g_stale_ticks--;
+    } else {
+        g_hw_timer = NULL;
+    }
+    uint64_t now = now_ms();
+    while (g_current < now) {
+        // Prochain instant utile : un créneau occupé du niveau 0 dans ce tour, sinon le début du tour suivant
+        uint64_t next = (g_current | (EI_TIMER_NB_SLOTS - 1)) + 1;
+        uint64_t tick;
+        if (level_next_tick(0, &tick) && tick < next) {
+            next = tick;
+        }
+        if (next > now) {
+            g_current = now;
+            break;
+        }
+        g_current = next;
+
+        // Début d'un tour : descendre les timers des niveaux supérieurs, du plus haut au plus bas
+        int top = 0;
+        while (top + 1 < EI_TIMER_NB_LEVELS &&
+               (g_current & (((uint64_t)1 << (EI_TIMER_LEVEL_BITS * (top + 1))) - 1)) == 0) {
+            top++;
+        }
+        for (int level = top; level > 0; level--) {
+            cascade(level);
+        }
+
+        int slot = (int)(g_current & (EI_TIMER_NB_SLOTS - 1));
+        ei_timer_t sentinel = &g_slots[0][slot];
+        while (!list_empty(sentinel)) {
+            ei_timer_t timer = sentinel->next;
+            wheel_remove(timer);
+            if (timer->expiry > g_current) {
+                // Rangé ici faute de portée suffisante lors de son insertion
+                wheel_insert(timer);
+            } else {
+                fire(timer);
+            }
+        }
+    }
+    schedule_hw_timer();
+}
+
+void ei_impl_timer_release(void) {
+    if (!g_initialized) {
+        return;
+    }
+    for (int level = 0; level < EI_TIMER_NB_LEVELS; level++) {
+        for (int slot = 0; slot < EI_TIMER_NB_SLOTS; slot++) {
+            ei_timer_t sentinel = &g_slots[level][slot];
+            while (!list_empty(sentinel)) {
+                ei_timer_t timer = sentinel->next;
+                list_unlink(timer);
+                owner_unlink(timer);
+                free(timer);
+            }
+        }
+    }
+    if (g_hw_timer != NULL) {
+        hw_event_cancel_app(g_hw_timer);
+        g_hw_timer = NULL;
+    }
+    g_stale_ticks = 0;
+    g_nb_timers = 0;
+    g_initialized = false;
+}
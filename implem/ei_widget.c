@@ -9,12 +9,110 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ei_widget_attributes.h"
+#include "ei_spatial_index.h"
+#include "ei_pick_buffer.h"
+#include "ei_widget_cache.h"
+#include "ei_timer.h"
+#include "ei_animate.h"
 
 
 
 ei_surface_t pick_surface;
 
 
+/* Table pick_id -> widget.
+ * Les ids sont denses (1, 2, 3...) : l'id lu dans la surface de picking indexe directement la table.
+ * Les ids libérés sont réutilisés via une pile. L'id 0 n'est jamais attribué. */
+#define EI_PICK_ID_MAX  0x00FFFFFF  // L'id est codé sur les 24 bits RGB de la pick_color
+
+static ei_widget_t* g_pick_table        = NULL;   // g_pick_table[id] : widget ou NULL
+static uint32_t     g_pick_table_size   = 0;
+static uint32_t     g_pick_next_id      = 1;      // Premier id jamais attribué
+static uint32_t*    g_pick_free_ids     = NULL;   // Pile des ids libérés
+static uint32_t     g_pick_nb_free      = 0;
+static uint32_t     g_pick_free_capacity = 0;
+
+static uint32_t pick_id_alloc(ei_widget_t widget) {
+    uint32_t id;
+    if (g_pick_nb_free > 0) {
+        id = g_pick_free_ids[--g_pick_nb_free];
+    } else {
+        assert(g_pick_next_id <= EI_PICK_ID_MAX && "Too many widgets for the picking offscreen");
+        id = g_pick_next_id++;
+        if (id >= g_pick_table_size) {
+            g_pick_table_size = g_pick_table_size == 0 ? 256 : 2 * g_pick_table_size;
+            g_pick_table = realloc(g_pick_table, g_pick_table_size * sizeof(ei_widget_t));
+            assert(g_pick_table != NULL && "Failed to grow the pick table");
+        }
+        if (pick_surface != NULL) {
+            ei_impl_pick_buffer_reserve(pick_surface, id);
+        }
+    }
+    g_pick_table[id] = widget;
+    return id;
+}
+
+static void pick_id_release(uint32_t id) {
+    g_pick_table[id] = NULL;
+
+    // Plus aucun widget : on libère tout, la prochaine application repart de l'id 1
+    if (g_pick_nb_free + 1 == g_pick_next_id - 1) {
+        free(g_pick_table);
+        free(g_pick_free_ids);
+        g_pick_table = NULL;
+        g_pick_free_ids = NULL;
+        g_pick_table_size = g_pick_free_capacity = g_pick_nb_free = 0;
+        g_pick_next_id = 1;
+        return;
+    }
+
+    if (g_pick_nb_free == g_pick_free_capacity) {
+        g_pick_free_capacity = g_pick_free_capacity == 0 ? 64 : 2 * g_pick_free_capacity;
+        g_pick_free_ids = realloc(g_pick_free_ids, g_pick_free_capacity * sizeof(uint32_t));
+        assert(g_pick_free_ids != NULL && "Failed to grow the pick free list");
+    }
+    g_pick_free_ids[g_pick_nb_free++] = id;
+}
+
+
+// Ajoute un widget en fin de la liste des enfants de son parent (au premier plan), en O(1).
+static void sibling_append(ei_widget_t widget) {
+    ei_widget_t parent = widget->parent;
+    // Rangs épuisés (après 2^32 mises au premier plan) : renuméroter les enfants dans l'ordre
+    if (parent->next_z_order == UINT32_MAX) {
+        parent->next_z_order = 0;
+        for (ei_widget_t child = parent->children_head; child != NULL; child = child->next_sibling) {
+            child->z_order = parent->next_z_order++;
+        }
+    }
+    widget->next_sibling = NULL;
+    widget->prev_sibling = parent->children_tail;
+    if (parent->children_tail == NULL) {
+        parent->children_head = widget;
+    } else {
+        parent->children_tail->next_sibling = widget;
+    }
+    parent->children_tail = widget;
+    widget->z_order = parent->next_z_order++;
+}
+
+// Retire un widget de la liste des enfants de son parent, en O(1).
+static void sibling_unlink(ei_widget_t widget) {
+    ei_widget_t parent = widget->parent;
+    if (widget->prev_sibling == NULL) {
+        parent->children_head = widget->next_sibling;
+    } else {
+        widget->prev_sibling->next_sibling = widget->next_sibling;
+    }
+    if (widget->next_sibling == NULL) {
+        parent->children_tail = widget->prev_sibling;
+    } else {
+        widget->next_sibling->prev_sibling = widget->prev_sibling;
+    }
+    widget->next_sibling = NULL;
+    widget->prev_sibling = NULL;
+}
+
 ei_widget_t ei_widget_create(ei_const_string_t class_name, ei_widget_t parent, ei_user_param_t user_data, ei_widget_destructor_t destructor)  {
     assert(class_name != NULL );
 
@@ -30,7 +128,8 @@ ei_widget_t ei_widget_create(ei_const_string_t class_name, ei_widget_t parent, e
     // Initialiser les champs communs
     ei_impl_widget_t* impl_widget = (ei_impl_widget_t*)widget;
     impl_widget->wclass = wclass;
-    impl_widget->pick_id = (uint32_t)(intptr_t)widget; // Utiliser l'adresse comme ID unique
+    impl_widget->wclass_ext = ei_impl_widgetclass_ext_from_class(wclass);
+    impl_widget->pick_id = pick_id_alloc(widget);
     impl_widget->pick_color.red   = (uint8_t)((impl_widget->pick_id & 0x00FF0000) >> 16);
     impl_widget->pick_color.green = (uint8_t)((impl_widget->pick_id & 0x0000FF00) >> 8);
     impl_widget->pick_color.blue  = (uint8_t)((impl_widget->pick_id & 0x000000FF));
@@ -41,22 +140,30 @@ ei_widget_t ei_widget_create(ei_const_string_t class_name, ei_widget_t parent, e
     impl_widget->children_head = NULL;
     impl_widget->children_tail = NULL;
     impl_widget->next_sibling = NULL;
+    impl_widget->prev_sibling = NULL;
     impl_widget->placer_params = NULL;
     impl_widget->requested_size = ei_size_zero();
     impl_widget->screen_location = ei_rect_zero();
+    impl_widget->subtree_bounds = ei_rect_zero();
+    impl_widget->nb_children = 0;
+    impl_widget->z_order = 0;
+    impl_widget->next_z_order = 0;
+    impl_widget->spatial_index = NULL;
+    impl_widget->indexed_bounds = ei_rect_zero();
+    impl_widget->index_stamp = 0;
+    impl_widget->cache = NULL;
+    impl_widget->layer = false;
+    impl_widget->timers = NULL;
+    impl_widget->animated = NULL;
+    impl_widget->layout_slot = 0;
     // Ne pas écraser content_rect ici: l'allocateur de classe peut l'avoir initialisé (ex: toplevel)
 
     // Ajouter le widget comme dernier enfant du parent
     if (parent != NULL) {
-        ei_impl_widget_t* parent_impl = (ei_impl_widget_t*)parent;
-        if (parent_impl->children_head == NULL) {
-            parent_impl->children_head = widget;
-            parent_impl->children_tail = widget;
-        } else {
-            ((ei_impl_widget_t*)parent_impl->children_tail)->next_sibling = widget;
-            parent_impl->children_tail = widget;
-        }
-        ei_app_invalidate_rect(ei_widget_get_screen_location(parent));
+        sibling_append(widget);
+        ei_impl_spatial_index_child_added(parent);
+        ei_impl_widget_cache_invalidate(parent);
+        ei_app_invalidate_rect(&parent->screen_location);
     }
 
     // Définir les valeurs par défaut de la classe (une seule fois)
@@ -68,7 +175,7 @@ ei_widget_t ei_widget_create(ei_const_string_t class_name, ei_widget_t parent, e
     }
 
     if (parent != NULL) {
-        ei_app_invalidate_rect(ei_widget_get_screen_location(parent));
+        ei_app_invalidate_rect(&parent->screen_location);
     }
 
     return widget;
@@ -86,6 +193,9 @@ void ei_widget_destroy(ei_widget_t widget) {
     if (impl_widget->placer_params != NULL) {
         ei_placer_forget(widget);
     }
+    // Bornes vides : la destruction des enfants ne recalcule plus les bornes de ce widget.
+    impl_widget->screen_location = ei_rect_zero();
+    impl_widget->subtree_bounds = ei_rect_zero();
 
     // Détruire récursivement tous les enfants
     ei_widget_t enfant = impl_widget->children_head;
@@ -97,35 +207,28 @@ void ei_widget_destroy(ei_widget_t widget) {
 
     // Retirer le widget de la liste des enfants de son parent
     if (impl_widget->parent != NULL) {
-        ei_impl_widget_t* parent_impl = (ei_impl_widget_t*)impl_widget->parent;
-        ei_widget_t prev_sibling = NULL;
-        ei_widget_t current = parent_impl->children_head;
-
-        while (current != NULL && current != widget) {
-            prev_sibling = current;
-            current = ((ei_impl_widget_t*)current)->next_sibling;
-        }
-
-        if (current == widget) {
-            if (prev_sibling == NULL) {
-                parent_impl->children_head = impl_widget->next_sibling;
-            } else {
-                ((ei_impl_widget_t*)prev_sibling)->next_sibling = impl_widget->next_sibling;
-            }
-            if (parent_impl->children_tail == widget) {
-                parent_impl->children_tail = prev_sibling;
-            }
-        }
+        sibling_unlink(widget);
+        ei_impl_spatial_index_child_removed(impl_widget->parent, widget);
+        ei_impl_widget_cache_invalidate(impl_widget->parent);
 
         // Invalider la zone du parent pour refléter la suppression
-        ei_app_invalidate_rect(ei_widget_get_screen_location(impl_widget->parent));
+        ei_app_invalidate_rect(&impl_widget->parent->screen_location);
+        ei_impl_widget_update_subtree_bounds(impl_widget->parent);
     }
 
+    ei_impl_spatial_index_free(widget);
+    ei_impl_app_cancel_repaints(widget);
+    ei_impl_widget_cache_free(widget);
+    ei_timer_cancel_owner(widget);
+    ei_animate_cancel(widget);
+
     // Appeler le destructeur utilisateur, si défini
     if (impl_widget->destructor != NULL) {
         impl_widget->destructor(widget);
     }
 
+    pick_id_release(impl_widget->pick_id);
+
     // Appeler la fonction de libération de la classe
     if (impl_widget->wclass->releasefunc != NULL) {
         impl_widget->wclass->releasefunc(widget);
@@ -139,77 +242,211 @@ void ei_widget_destroy(ei_widget_t widget) {
     free(widget);
 }
 
-bool ei_widget_is_displayed(ei_widget_t widget) {
-    assert(widget != NULL && "hmm , un widget NULL !! ");
-    return ((ei_impl_widget_t*)widget)->placer_params != NULL;
+// Vrai si un frère suivant d'un widget (dessiné après lui, donc par-dessus) touche rect.
+static bool later_sibling_overlaps(ei_widget_t widget, const ei_rect_t* rect) {
+    ei_widget_t parent = widget->parent;
+    ei_rect_t inter;
+    if (parent != NULL && parent->spatial_index != NULL) {
+        ei_widget_t* candidates = NULL;
+        size_t capacity = 0;
+        size_t nb = ei_impl_spatial_index_query(parent, rect, &candidates, &capacity);
+        bool overlaps = nb > 0 && candidates[nb - 1]->z_order > widget->z_order;
+        free(candidates);
+        return overlaps;
+    }
+    for (ei_widget_t sibling = widget->next_sibling; sibling != NULL; sibling = sibling->next_sibling) {
+        if (intersection_rect(&inter, &sibling->subtree_bounds, rect)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-// Helper: depth-first search to find widget by pick color.
-static ei_widget_t find_widget_by_pick_color(ei_widget_t root, const ei_color_t* color) {
-    if (root == NULL || color == NULL) return NULL;
-    ei_impl_widget_t* impl = (ei_impl_widget_t*)root;
-    if (memcmp(&impl->pick_color, color, sizeof(ei_color_t)) == 0) {
-        return root;
+bool ei_impl_widget_is_unobscured(ei_widget_t widget, const ei_rect_t* rect) {
+    assert(widget != NULL && rect != NULL);
+    ei_rect_t inter, overlay;
+    // À chaque niveau : dans le content_rect du parent, sans frère suivant ni dessin du parent par-dessus
+    for (ei_widget_t level = widget; level->parent != NULL; level = level->parent) {
+        ei_widget_t parent = level->parent;
+        if (!intersection_rect(&inter, rect, parent->content_rect) || memcmp(&inter, rect, sizeof(ei_rect_t)) != 0 ||
+            later_sibling_overlaps(level, rect) ||
+            parent->wclass_ext == NULL ||
+            (parent->wclass_ext->overlayfunc != NULL &&
+             parent->wclass_ext->overlayfunc(parent, &overlay) && intersection_rect(&inter, &overlay, rect))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ei_widget_repaint(ei_widget_t widget) {
+    assert(widget != NULL && "hmm , un widget NULL !! ");
+    ei_impl_widget_cache_invalidate(widget);
+    if (!ei_widget_is_displayed(widget) && widget != ei_app_root_widget()) {
+        return;
+    }
+
+    // Partie visible du widget : screen_location clippée par les content_rect des ancêtres
+    ei_rect_t clip = widget->screen_location;
+    for (ei_widget_t ancestor = widget->parent; ancestor != NULL; ancestor = ancestor->parent) {
+        if (!intersection_rect(&clip, &clip, ancestor->content_rect)) {
+            return;
+        }
+    }
+    if (clip.size.width <= 0 || clip.size.height <= 0) {
+        return;
     }
-    // Traverse children
-    ei_widget_t child = impl->children_head;
-    while (child) {
-        ei_widget_t found = find_widget_by_pick_color(child, color);
-        if (found) return found;
-        child = ((ei_impl_widget_t*)child)->next_sibling;
+
+    // Ancêtre le plus proche (le widget compris) qui est opaque sur toute la zone
+    ei_widget_t start = widget;
+    ei_rect_t opaque, inter;
+    while (start != NULL &&
+           !(ei_impl_widget_opaque_rect(start, &opaque) && intersection_rect(&inter, &opaque, &clip) &&
+             memcmp(&inter, &clip, sizeof(ei_rect_t)) == 0)) {
+        start = start->parent;
+    }
+
+    // Rien de ce qui est dessiné après "start" ne doit recouvrir la zone
+    if (start == NULL || !ei_impl_widget_is_unobscured(start, &clip)) {
+        ei_impl_app_invalidate_paint(&clip);
+    } else {
+        ei_impl_app_queue_repaint(start, &clip);
     }
-    return NULL;
 }
 
-ei_widget_t ei_widget_pick(ei_point_t* where) {
-    assert(where != NULL && "Location cannot be NULL");
+// Invalide la partie de "area" recouverte par un frère suivant du widget.
+static void invalidate_if_covered(ei_widget_t sibling, const ei_rect_t* area) {
+    ei_rect_t covered;
+    if (intersection_rect(&covered, &sibling->subtree_bounds, area)) {
+        ei_app_invalidate_rect(&covered);
+    }
+}
 
-    // Obtenir la surface de picking
-    if (pick_surface == NULL) {
-        return NULL; // Application non initialisée
+void ei_widget_bring_to_front(ei_widget_t widget) {
+    assert(widget != NULL && "hmm , un widget NULL !! ");
+    ei_widget_t parent = widget->parent;
+    if (parent == NULL || parent->children_tail == widget) {
+        return;
     }
 
-    // Vérifier que le point est dans les limites de la surface
-    ei_rect_t surface_rect = hw_surface_get_rect(pick_surface);
-    if (where->x < surface_rect.top_left.x || where->x >= surface_rect.top_left.x + surface_rect.size.width ||
-        where->y < surface_rect.top_left.y || where->y >= surface_rect.top_left.y + surface_rect.size.height) {
-        return NULL;
+    // Seules les parties du widget que recouvraient ses frères suivants changent à l'écran
+    ei_rect_t area;
+    if (intersection_rect(&area, &widget->subtree_bounds, parent->content_rect)) {
+        if (parent->spatial_index != NULL) {
+            ei_widget_t* candidates = NULL;
+            size_t capacity = 0;
+            size_t nb = ei_impl_spatial_index_query(parent, &area, &candidates, &capacity);
+            for (size_t i = 0; i < nb; i++) {
+                if (candidates[i]->z_order > widget->z_order) {
+                    invalidate_if_covered(candidates[i], &area);
+                }
+            }
+            free(candidates);
+        } else {
+            for (ei_widget_t sibling = widget->next_sibling; sibling != NULL; sibling = sibling->next_sibling) {
+                invalidate_if_covered(sibling, &area);
+            }
+        }
+    }
+
+    sibling_unlink(widget);
+    sibling_append(widget);
+    // Les calques sont composés par-dessus le cache du parent, qui ne les contient pas
+    if (!widget->layer) {
+        ei_impl_widget_cache_invalidate(parent);
     }
+}
+
+void ei_widget_set_cached(ei_widget_t widget, bool cached) {
+    assert(widget != NULL && "hmm , un widget NULL !! ");
+    ei_impl_widget_cache_enable(widget, cached);
+}
 
-    // Verrouiller la surface
-    hw_surface_lock(pick_surface);
+void ei_widget_set_layered(ei_widget_t widget, bool layered) {
+    assert(widget != NULL && widget->parent == ei_app_root_widget() && "Only children of the root widget can be layers");
+    ei_impl_widget_cache_set_layer(widget, layered);
+}
 
-    // Obtenir le buffer de pixels
-    uint8_t* buffer = hw_surface_get_buffer(pick_surface);
-    ei_size_t surface_size = hw_surface_get_size(pick_surface);
+void ei_widget_set_cache_budget(size_t bytes) {
+    ei_impl_widget_cache_set_budget(bytes);
+}
 
-    // Obtenir les indices des canaux
-    int ir, ig, ib, ia;
-    hw_surface_get_channel_indices(pick_surface, &ir, &ig, &ib, &ia);
+bool ei_widget_is_displayed(ei_widget_t widget) {
+    assert(widget != NULL && "hmm , un widget NULL !! ");
+    return ((ei_impl_widget_t*)widget)->placer_params != NULL;
+}
 
-    // Calculer l'offset du pixel à la position (where->x, where->y)
-    int bytes_per_pixel = 4; // Supposé 32 bits par pixel (RGBA)
-    size_t pixel_offset = (where->y * surface_size.width + where->x) * bytes_per_pixel;
+static bool point_in_rect(const ei_point_t* point, const ei_rect_t* rect) {
+    return point->x >= rect->top_left.x && point->x < rect->top_left.x + rect->size.width &&
+           point->y >= rect->top_left.y && point->y < rect->top_left.y + rect->size.height;
+}
 
-    // Lire les composantes du pixel
-    ei_color_t pixel_color;
-    pixel_color.red = buffer[pixel_offset + ir];
-    pixel_color.green = buffer[pixel_offset + ig];
-    pixel_color.blue = buffer[pixel_offset + ib];
-    pixel_color.alpha = (ia >= 0) ? buffer[pixel_offset + ia] : 255; // Opaque si pas de canal alpha
-    
-        // Debug: print the pixel color and coordinates
-        printf("[PICK DEBUG] at (%d,%d): color RGBA=(%d,%d,%d,%d)\n", where->x, where->y, pixel_color.red, pixel_color.green, pixel_color.blue, pixel_color.alpha);
+// Picking géométrique : parcourt les enfants du dernier dessiné (au-dessus) au premier,
+// puis teste le widget lui-même. "clipper" est la zone où le widget est visible (content_rect des ancêtres).
+static ei_widget_t pick_geometric(ei_widget_t widget, const ei_point_t* where, const ei_rect_t* clipper) {
+    if (!point_in_rect(where, &widget->subtree_bounds) || !point_in_rect(where, clipper)) {
+        return NULL;
+    }
 
-    // Déverrouiller la surface
-    hw_surface_unlock(pick_surface);
+    ei_rect_t children_clipper;
+    if (widget->children_head != NULL &&
+        intersection_rect(&children_clipper, clipper, widget->content_rect) &&
+        point_in_rect(where, &children_clipper)) {
+        if (widget->spatial_index != NULL) {
+            ei_widget_t* candidates = NULL;
+            size_t capacity = 0;
+            ei_rect_t point_rect = ei_rect(*where, ei_size(1, 1));
+            size_t nb = ei_impl_spatial_index_query(widget, &point_rect, &candidates, &capacity);
+            ei_widget_t found = NULL;
+            while (nb > 0 && found == NULL) {
+                found = pick_geometric(candidates[--nb], where, &children_clipper);
+            }
+            free(candidates);
+            if (found != NULL) {
+                return found;
+            }
+        } else {
+            for (ei_widget_t child = widget->children_tail; child != NULL; child = child->prev_sibling) {
+                ei_widget_t found = pick_geometric(child, where, &children_clipper);
+                if (found != NULL) {
+                    return found;
+                }
+            }
+        }
+    }
 
-    // Si l'alpha est 0 (couleur de fond du pick surface), aucun widget
-    if (pixel_color.alpha == 0) {
+    if (!point_in_rect(where, &widget->screen_location)) {
+        return NULL;
+    }
+    if (widget->wclass_ext != NULL && widget->wclass_ext->hittestfunc != NULL &&
+        !widget->wclass_ext->hittestfunc(widget, where)) {
         return NULL;
     }
+    return widget;
+}
+
+ei_widget_t ei_widget_pick(ei_point_t* where) {
+    assert(where != NULL && "Location cannot be NULL");
+
+    // Pas de surface de picking : mode géométrique (ou application non initialisée)
+    if (pick_surface == NULL) {
+        ei_widget_t root = ei_app_root_widget();
+        if (root == NULL) {
+            return NULL;
+        }
+        return pick_geometric(root, where, &root->screen_location);
+    }
+
+    // Rendre d'abord les zones en attente qui contiennent le point
+    ei_rect_t pending;
+    while (ei_impl_pick_buffer_take_pending(pick_surface, *where, &pending)) {
+        ei_impl_widget_draw_pick(ei_app_root_widget(), &pending);
+    }
 
-    // Rechercher dans l'arbre le widget correspondant à cette pick_color
-    ei_widget_t root = ei_app_root_widget();
-    return find_widget_by_pick_color(root, &pixel_color);
-}
\ No newline at end of file
+    // Lecture directe du pick_id sous le point (0 : aucun widget ou hors du buffer)
+    uint32_t id = ei_impl_pick_buffer_get(pick_surface, *where);
+    if (id == 0 || id >= g_pick_next_id) {
+        return NULL;
+    }
+    return g_pick_table[id];
+}
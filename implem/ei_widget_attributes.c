@@ -1,6 +1,8 @@
 #include "ei_widget_attributes.h"
 #include "ei_implementation.h"
 #include "ei_application.h"
+#include "ei_widget_cache.h"
+#include "ei_spatial_index.h"
 #include <assert.h>
 #include <stdlib.h>
 
@@ -61,11 +63,13 @@ void ei_widget_set_requested_size(ei_widget_t widget, ei_size_t requested_size)
 
 const ei_rect_t* ei_widget_get_screen_location(ei_widget_t widget) {
     assert(widget != NULL && "hmm , un widget NULL !! ");
+    ei_impl_layout_flush();
     return &widget->screen_location;
 }
 
 const ei_rect_t* ei_widget_get_content_rect(ei_widget_t widget) {
     assert(widget != NULL && "hmm , un widget NULL !! ");
+    ei_impl_layout_flush();
     return widget->content_rect ? widget->content_rect : &widget->screen_location;
 }
 
@@ -78,6 +82,9 @@ void ei_widget_set_content_rect(ei_widget_t widget, const ei_rect_t* content_rec
     }
     // Copier le nouveau rectangle
     *impl_widget->content_rect = *content_rect;
+    ei_impl_spatial_index_container_moved(widget);
+    ei_impl_widget_update_subtree_bounds(widget);
+    ei_impl_widget_cache_invalidate(widget);
 
     // Invalider la zone pour redessiner
     ei_app_invalidate_rect(&impl_widget->screen_location);
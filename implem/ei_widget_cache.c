@@ -0,0 +1,318 @@
+#include "ei_widget_cache.h"
+#include "ei_implementation.h"
+#include "ei_application.h"
+#include "ei_utils.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ei_impl_widget_cache_t {
+    ei_widget_t  widget;
+    bool         valid;
+    ei_size_t    size;          // Taille du widget lors du rendu
+    ei_rect_t    valid_part;    // Partie rendue, relative au coin haut gauche du widget
+    uint32_t*    pixels;        // size.width * size.height pixels, NULL si évincé
+    size_t       bytes;
+    struct ei_impl_widget_cache_t* lru_prev;  // Vers les caches dessinés plus récemment
+    struct ei_impl_widget_cache_t* lru_next;
+};
+
+static int                      g_nb_caches     = 0;    // Widgets avec un cache activé
+static size_t                   g_budget        = EI_WIDGET_CACHE_DEFAULT_BUDGET;
+static size_t                   g_used          = 0;
+static ei_impl_widget_cache_t*  g_lru_head      = NULL; // Le plus récemment dessiné
+static ei_impl_widget_cache_t*  g_lru_tail      = NULL;
+static ei_surface_t             g_scratch       = NULL;
+static int                      g_rendering     = 0;    // > 0 pendant un rendu dans g_scratch
+static ei_widget_t              g_render_target = NULL; // Widget dont le cache est en cours de rendu
+static int                      g_nb_layers     = 0;    // Enfants de la racine rendus comme calques
+
+
+static void lru_unlink(ei_impl_widget_cache_t* cache) {
+    if (cache->lru_prev) cache->lru_prev->lru_next = cache->lru_next; else if (g_lru_head == cache) g_lru_head = cache->lru_next;
+    if (cache->lru_next) cache->lru_next->lru_prev = cache->lru_prev; else if (g_lru_tail == cache) g_lru_tail = cache->lru_prev;
+    cache->lru_prev = cache->lru_next = NULL;
+}
+
+static void lru_push_front(ei_impl_widget_cache_t* cache) {
+    cache->lru_next = g_lru_head;
+    if (g_lru_head) g_lru_head->lru_prev = cache;
+    g_lru_head = cache;
+    if (g_lru_tail == NULL) g_lru_tail = cache;
+}
+
+static void cache_drop_pixels(ei_impl_widget_cache_t* cache) {
+    if (cache->pixels == NULL) {
+        return;
+    }
+    lru_unlink(cache);
+    free(cache->pixels);
+    cache->pixels = NULL;
+    g_used -= cache->bytes;
+    cache->bytes = 0;
+    cache->valid = false;
+}
+
+// Évince les caches les moins récemment dessinés jusqu'à ce que "needed" octets tiennent dans le budget.
+static void evict_for(size_t needed) {
+    while (g_lru_tail != NULL && g_used + needed > g_budget) {
+        cache_drop_pixels(g_lru_tail);
+    }
+}
+
+void ei_impl_widget_cache_enable(ei_widget_t widget, bool enabled) {
+    assert(widget != NULL);
+    if (!enabled) {
+        ei_impl_widget_cache_free(widget);
+        return;
+    }
+    if (widget->cache != NULL) {
+        return;
+    }
+    widget->cache = calloc(1, sizeof(ei_impl_widget_cache_t));
+    assert(widget->cache != NULL && "Failed to allocate widget cache");
+    widget->cache->widget = widget;
+    g_nb_caches++;
+}
+
+void ei_impl_widget_cache_set_layer(ei_widget_t widget, bool layer) {
+    assert(widget != NULL && widget->parent != NULL);
+    if (widget->layer == layer) {
+        return;
+    }
+    widget->layer = layer;
+    if (layer) {
+        g_nb_layers++;
+        ei_impl_widget_cache_enable(widget, true);
+        // La racine sert de calque de fond : elle est rendue sans ses calques
+        ei_impl_widget_cache_enable(widget->parent, true);
+    } else {
+        ei_impl_widget_cache_free(widget);
+        if (--g_nb_layers == 0) {
+            ei_impl_widget_cache_free(widget->parent);
+        }
+    }
+    if (widget->parent->cache != NULL) {
+        widget->parent->cache->valid = false;
+    }
+}
+
+bool ei_impl_widget_cache_skips(ei_widget_t child) {
+    return child->layer && g_render_target != NULL && child->parent == g_render_target;
+}
+
+void ei_impl_widget_cache_set_budget(size_t bytes) {
+    g_budget = bytes;
+    evict_for(0);
+}
+
+void ei_impl_widget_cache_invalidate(ei_widget_t widget) {
+    if (g_nb_caches == 0) {
+        return;
+    }
+    for (; widget != NULL; widget = widget->parent) {
+        if (widget->cache != NULL) {
+            widget->cache->valid = false;
+        }
+        if (widget->layer) {
+            // Le cache du parent ne contient pas les calques
+            return;
+        }
+    }
+}
+
+// Surface de travail de la taille de la fenêtre, créée au premier usage. NULL si la création échoue.
+static ei_surface_t scratch_surface(void) {
+    ei_size_t root_size = hw_surface_get_size(ei_app_root_surface());
+    if (g_scratch != NULL) {
+        ei_size_t scratch_size = hw_surface_get_size(g_scratch);
+        if (scratch_size.width != root_size.width || scratch_size.height != root_size.height) {
+            ei_impl_widget_cache_release();
+        }
+    }
+    if (g_scratch == NULL) {
+        g_scratch = hw_surface_create(ei_app_root_surface(), root_size, false);
+    }
+    return g_scratch;
+}
+
+// Rend le widget dans la surface de travail et copie la partie "rect" dans pixels (rect->size.width
+// pixels par ligne). Seule la partie dans la fenêtre, retournée dans visible, peut être rendue.
+static bool render_part(ei_widget_t widget, const ei_rect_t* rect, uint32_t* pixels, ei_rect_t* visible) {
+    if (scratch_surface() == NULL) {
+        return false;
+    }
+    ei_size_t root_size = hw_surface_get_size(g_scratch);
+
+    ei_rect_t scratch_rect = ei_rect(ei_point_zero(), root_size);
+    if (!intersection_rect(visible, rect, &scratch_rect)) {
+        return false;
+    }
+
+    hw_surface_lock(g_scratch);
+    g_rendering++;
+    g_render_target = widget;
+    widget->wclass->drawfunc(widget, g_scratch, NULL, visible);
+    g_render_target = NULL;
+    g_rendering--;
+
+    uint32_t* scratch = (uint32_t*)hw_surface_get_buffer(g_scratch);
+    int rel_x = visible->top_left.x - rect->top_left.x;
+    int rel_y = visible->top_left.y - rect->top_left.y;
+    for (int y = 0; y < visible->size.height; y++) {
+        memcpy(pixels + (size_t)(rel_y + y) * rect->size.width + rel_x,
+               scratch + (size_t)(visible->top_left.y + y) * root_size.width + visible->top_left.x,
+               visible->size.width * sizeof(uint32_t));
+    }
+    hw_surface_unlock(g_scratch);
+    return true;
+}
+
+// Rend le widget dans la surface de travail et copie le résultat dans son cache.
+static bool cache_render(ei_widget_t widget) {
+    ei_impl_widget_cache_t* cache = widget->cache;
+    ei_rect_t rect = widget->screen_location;
+    size_t bytes = (size_t)rect.size.width * rect.size.height * sizeof(uint32_t);
+    if (bytes > g_budget) {
+        cache_drop_pixels(cache);
+        return false;
+    }
+
+    if (cache->pixels == NULL || cache->bytes != bytes) {
+        cache_drop_pixels(cache);
+        evict_for(bytes);
+        cache->pixels = malloc(bytes);
+        if (cache->pixels == NULL) {
+            return false;
+        }
+        cache->bytes = bytes;
+        g_used += bytes;
+        lru_push_front(cache);
+    }
+
+    ei_rect_t visible;
+    if (!render_part(widget, &rect, cache->pixels, &visible)) {
+        return false;
+    }
+
+    cache->size = rect.size;
+    cache->valid_part = ei_rect(ei_point(visible.top_left.x - rect.top_left.x, visible.top_left.y - rect.top_left.y),
+                                visible.size);
+    cache->valid = true;
+    return true;
+}
+
+bool ei_impl_widget_render(ei_widget_t widget, const ei_rect_t* rect, uint32_t* pixels) {
+    assert(g_rendering == 0 && "ei_impl_widget_render during a redraw");
+    ei_rect_t visible;
+    if (render_part(widget, rect, pixels, &visible)) {
+        return true;
+    }
+    // Rien dans la fenêtre : les pixels restent inchangés
+    return g_scratch != NULL;
+}
+
+bool ei_impl_widget_render_pick(ei_widget_t widget, const ei_rect_t* clipper) {
+    if (pick_surface == NULL || g_rendering > 0 || scratch_surface() == NULL) {
+        return false;
+    }
+    // Les couleurs dessinées dans la surface de travail sont perdues, seul le picking compte
+    ei_rect_t clip = *clipper;
+    hw_surface_lock(g_scratch);
+    g_rendering++;
+    widget->wclass->drawfunc(widget, g_scratch, pick_surface, &clip);
+    g_rendering--;
+    hw_surface_unlock(g_scratch);
+    return true;
+}
+
+static bool rect_contains(const ei_rect_t* outer, const ei_rect_t* inner) {
+    return inner->top_left.x >= outer->top_left.x && inner->top_left.y >= outer->top_left.y &&
+           inner->top_left.x + inner->size.width <= outer->top_left.x + outer->size.width &&
+           inner->top_left.y + inner->size.height <= outer->top_left.y + outer->size.height;
+}
+
+// Dessine par dessus le cache d'un widget ses enfants calques, du plus ancien au plus récent.
+static void composite_layers(ei_widget_t widget, ei_surface_t surface, const ei_rect_t* area) {
+    ei_rect_t clipper;
+    if (!intersection_rect(&clipper, widget->content_rect, area)) {
+        return;
+    }
+    for (ei_widget_t child = widget->children_head; child != NULL; child = child->next_sibling) {
+        ei_rect_t piece;
+        if (child->layer && intersection_rect(&piece, &child->subtree_bounds, &clipper) &&
+            !ei_impl_widget_cache_draw(child, surface, &piece)) {
+            child->wclass->drawfunc(child, surface, NULL, &piece);
+        }
+    }
+}
+
+bool ei_impl_widget_cache_draw(ei_widget_t widget, ei_surface_t surface, const ei_rect_t* clipper) {
+    ei_impl_widget_cache_t* cache = widget->cache;
+    if (cache == NULL) {
+        return false;
+    }
+    ei_rect_t rect = widget->screen_location;
+    ei_rect_t opaque;
+    if (rect.size.width <= 0 || rect.size.height <= 0 ||
+        !ei_impl_widget_opaque_rect(widget, &opaque) || !rect_contains(&opaque, &rect)) {
+        return false;
+    }
+
+    ei_size_t surface_size = hw_surface_get_size(surface);
+    ei_rect_t area;
+    ei_rect_t surface_rect = ei_rect(ei_point_zero(), surface_size);
+    if (!intersection_rect(&area, &rect, &surface_rect) ||
+        (clipper != NULL && !intersection_rect(&area, &area, clipper))) {
+        return true;
+    }
+
+    // Partie demandée, relative au widget
+    ei_rect_t needed = ei_rect(ei_point(area.top_left.x - rect.top_left.x, area.top_left.y - rect.top_left.y), area.size);
+    bool usable = cache->valid && cache->pixels != NULL &&
+                  cache->size.width == rect.size.width && cache->size.height == rect.size.height &&
+                  rect_contains(&cache->valid_part, &needed);
+    if (!usable) {
+        // Pas de rendu imbriqué : la surface de travail contient déjà le rendu d'un ancêtre.
+        // Pas de rendu en qualité réduite non plus, il resterait dans le cache.
+        if (g_rendering > 0 || ei_impl_app_low_quality() || !cache_render(widget)) {
+            return false;
+        }
+    }
+
+    uint32_t* target = (uint32_t*)hw_surface_get_buffer(surface);
+    for (int y = 0; y < area.size.height; y++) {
+        memcpy(target + (size_t)(area.top_left.y + y) * surface_size.width + area.top_left.x,
+               cache->pixels + (size_t)(needed.top_left.y + y) * rect.size.width + needed.top_left.x,
+               area.size.width * sizeof(uint32_t));
+    }
+
+    lru_unlink(cache);
+    lru_push_front(cache);
+
+    if (g_nb_layers > 0 && widget->parent == NULL) {
+        composite_layers(widget, surface, &area);
+    }
+    return true;
+}
+
+void ei_impl_widget_cache_free(ei_widget_t widget) {
+    if (widget->layer && widget->parent != NULL) {
+        ei_impl_widget_cache_set_layer(widget, false);
+    }
+    ei_impl_widget_cache_t* cache = widget->cache;
+    if (cache == NULL) {
+        return;
+    }
+    cache_drop_pixels(cache);
+    free(cache);
+    widget->cache = NULL;
+    g_nb_caches--;
+}
+
+void ei_impl_widget_cache_release(void) {
+    if (g_scratch != NULL) {
+        hw_surface_free(g_scratch);
+        g_scratch = NULL;
+    }
+}
@@ -0,0 +1,116 @@
+/**
+ * @file  ei_widget_cache.h
+ *
+ * @brief Retained rendering of widgets (see \ref ei_widget_set_cached): the subtree of a cached
+ *        widget is rendered once, kept in a compact pixel buffer, and copied back to the screen
+ *        on the next redraws until something in the subtree changes.
+ *        The buffers of all the widgets share a memory budget, the least recently drawn ones
+ *        are evicted first.
+ *
+ *        Rendering goes through a scratch surface of the size of the root window, so that draw
+ *        functions keep working in screen coordinates. Only widgets that are opaque over their
+ *        whole screen_location use their cache: the others are drawn normally.
+ *
+ *        Children of the root widget can also be layers: the root widget then caches only
+ *        its background and the other children, and the layers are composited over it.
+ *
+ */
+
+#ifndef EI_WIDGET_CACHE_H
+#define EI_WIDGET_CACHE_H
+
+#include "ei_types.h"
+#include "hw_interface.h"
+#include <stddef.h>
+
+/**
+ * \brief	Default memory budget of all the widget caches, in bytes.
+ */
+#define EI_WIDGET_CACHE_DEFAULT_BUDGET	(32 * 1024 * 1024)
+
+/**
+ * \brief	Opaque cache structure, owned by the widget (field cache).
+ */
+typedef struct ei_impl_widget_cache_t ei_impl_widget_cache_t;
+
+/**
+ * \brief	Enables or disables the cache of a widget.
+ */
+void ei_impl_widget_cache_enable(ei_widget_t widget, bool enabled);
+
+/**
+ * \brief	Changes the memory budget, evicting caches if needed.
+ */
+void ei_impl_widget_cache_set_budget(size_t bytes);
+
+/**
+ * \brief	Makes a child of the root widget a layer (see \ref ei_widget_set_layered): it gets its
+ *		own cache, and the cache of the root widget (the background layer) is rendered
+ *		without it. Drawing the root widget from its cache then composites the layers
+ *		over it by z-order, so that moving a layer only costs copies.
+ */
+void ei_impl_widget_cache_set_layer(ei_widget_t widget, bool layer);
+
+/**
+ * \brief	Tells \ref ei_impl_widget_draw_children to leave out a child: true for the layers
+ *		while the background layer is rendered.
+ */
+bool ei_impl_widget_cache_skips(ei_widget_t child);
+
+/**
+ * \brief	Must be called when the rendering of a widget may have changed: the caches of the
+ *		widget and of all its ancestors are discarded. Does nothing when no widget is cached.
+ *
+ * @param	widget		The widget that changed.
+ */
+void ei_impl_widget_cache_invalidate(ei_widget_t widget);
+
+/**
+ * \brief	Draws a cached widget, rendering its cache first if it is not valid.
+ *
+ * @param	widget		The widget.
+ * @param	surface		The locked surface to draw into: the root surface, or the scratch surface.
+ * @param	clipper		The drawing is restricted within this rectangle. May be NULL.
+ *
+ * @return			false if the widget has no usable cache: the caller must call its drawfunc.
+ */
+bool ei_impl_widget_cache_draw(ei_widget_t widget, ei_surface_t surface, const ei_rect_t* clipper);
+
+/**
+ * \brief	Renders a widget and its children in the scratch surface, as if nothing covered it,
+ *		and copies a part of the rendering. Must not be called during a redraw.
+ *
+ * @param	widget		The widget.
+ * @param	rect		The part to copy, in screen coordinates.
+ * @param	pixels		Receives rect->size.width * rect->size.height pixels, in the format of the
+ *				root surface. The pixels outside of the root surface are left unchanged.
+ *
+ * @return			false if the scratch surface could not be created.
+ */
+bool ei_impl_widget_render(ei_widget_t widget, const ei_rect_t* rect, uint32_t* pixels);
+
+/**
+ * \brief	Draws the pick shape of a widget whose class has no private hooks (see
+ *		\ref ei_impl_widgetclass_ext_t): its drawfunc is called with the pick buffer as
+ *		pick_surface, and the scratch surface, whose content is discarded, as surface.
+ *		The children of the widget are not drawn in the pick buffer.
+ *
+ * @param	widget		The widget.
+ * @param	clipper		The part of the pick buffer to draw, in screen coordinates.
+ *
+ * @return			false if nothing was drawn: no pick buffer, scratch surface not available
+ *				or called during a rendering in the scratch surface.
+ */
+bool ei_impl_widget_render_pick(ei_widget_t widget, const ei_rect_t* clipper);
+
+/**
+ * \brief	Frees the cache of a widget, if any.
+ */
+void ei_impl_widget_cache_free(ei_widget_t widget);
+
+/**
+ * \brief	Frees the scratch surface. Called by \ref ei_app_free.
+ */
+void ei_impl_widget_cache_release(void);
+
+#endif
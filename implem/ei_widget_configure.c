@@ -13,13 +13,17 @@
 #include "ei_application.h"
 #include <stdio.h>
 #include "ei_implementation.h"
+#include "ei_widget_cache.h"
+#include "ei_timer.h"
 
 
 #define max(a, b) ((a) > (b) ? (a) : (b))
+#define min(a, b) ((a) < (b) ? (a) : (b))
 
 #define TOPLEVEL_TITLE_BAR_HEIGHT 25
 #define TOPLEVEL_DECORATION_SIZE 15 // Pour le bouton de fermeture et la poignée de redim.
 #define TOPLEVEL_RESIZE_HANDLE_SIZE 15
+#define TOPLEVEL_DRAG_SETTLE_MS 50  // Sans mouvement pendant ce délai, la position prédite est corrigée
 
 
 
@@ -117,6 +121,8 @@ void ei_frame_configure(ei_widget_t widget,
     if (geometry_changed && frame->widget.placer_params != NULL) {
         ei_impl_placer_run(widget);
     }
+    // Couleurs, relief, texte : simple repeinte
+    ei_widget_repaint(widget);
 }
 
 ei_widget_t frame_allocfunc(void) {
@@ -237,7 +243,34 @@ void frame_setdefaultsfunc(ei_widget_t widget) {
     frame->img_anchor = ei_anc_center;
 }
 
+bool frame_opaquefunc(ei_widget_t widget, ei_rect_t* opaque_rect) {
+    ei_impl_frame_t* frame = (ei_impl_frame_t*)widget;
+    if (frame->color.alpha != 0xff) {
+        return false;
+    }
+    // Sans relief, le fond couvre tout le rectangle ; avec relief, seul le centre est garanti.
+    int inset = (frame->relief != ei_relief_none) ? frame->border_width : 0;
+    *opaque_rect = frame->widget.screen_location;
+    opaque_rect->top_left.x += inset;
+    opaque_rect->top_left.y += inset;
+    opaque_rect->size.width -= 2 * inset;
+    opaque_rect->size.height -= 2 * inset;
+    return true;
+}
+
+int frame_invariancefunc(ei_widget_t widget) {
+    ei_impl_frame_t* frame = (ei_impl_frame_t*)widget;
+    // Un aplat opaque sans bordure, texte ni image : chaque pixel ne dépend pas de la géométrie.
+    // Les enfants ne sont pas replacés quand une frame bouge : ils restent où ils sont à l'écran.
+    if (frame->color.alpha != 0xff || frame->relief != ei_relief_none || frame->border_width != 0 ||
+        (frame->text != NULL && frame->text[0] != '\0') || frame->img != NULL) {
+        return ei_impl_invariant_none;
+    }
+    return ei_impl_invariant_translation | ei_impl_invariant_resize;
+}
+
 static ei_widgetclass_t g_frame_class;
+static ei_impl_widgetclass_ext_t g_frame_class_ext;
 
 void ei_frame_register_class(void) {
     strncpy(g_frame_class.name, "frame", sizeof(g_frame_class.name) - 1);
@@ -250,6 +283,11 @@ void ei_frame_register_class(void) {
     g_frame_class.handlefunc = NULL;
     g_frame_class.next = NULL;
     ei_widgetclass_register(&g_frame_class);
+
+    g_frame_class_ext.wclass = &g_frame_class;
+    g_frame_class_ext.opaquefunc = frame_opaquefunc;
+    g_frame_class_ext.invariancefunc = frame_invariancefunc;
+    ei_impl_widgetclass_register_ext(&g_frame_class_ext);
 }
 
 
@@ -277,12 +315,14 @@ void ei_button_configure(ei_widget_t widget,
 
     bool geometry_changed = false;
     bool image_changed = false; // Pour savoir si on doit recalculer la taille à cause de l'image
+    bool shape_changed = false; // La forme touchée par le picking (coins arrondis) a changé
 
     // Gérer d'abord les attributs qui ne dépendent pas de l'image/texte
     if (color != NULL) {
         button->color = *color;
     }
     if (border_width != NULL) {
+        shape_changed |= button->border_width != *border_width;
         button->border_width = *border_width;
         geometry_changed = true;
     }
@@ -290,6 +330,7 @@ void ei_button_configure(ei_widget_t widget,
         button->relief = *relief;
     }
     if (corner_radius != NULL) {
+        shape_changed |= button->corner_radius != *corner_radius;
         button->corner_radius = *corner_radius;
     }
     if (callback != NULL) {
@@ -432,6 +473,11 @@ void ei_button_configure(ei_widget_t widget,
     if ((geometry_changed || image_changed) && button->widget.placer_params != NULL) {
         ei_impl_placer_run(widget);
     }
+    // Couleurs, relief, texte : simple repeinte
+    ei_widget_repaint(widget);
+    if (shape_changed && ei_widget_is_displayed(widget)) {
+        ei_impl_app_invalidate_pick(&button->widget.screen_location);
+    }
 }
 
 
@@ -614,7 +660,7 @@ bool button_handlefunc(ei_widget_t widget, ei_event_t* event) {
                 button->is_pressed = true;
                 ei_event_set_active_widget(widget);
                 if (!was_pressed) {
-                    ei_app_invalidate_rect(screen_loc);
+                    ei_widget_repaint(widget);
                 }
                 event_handled = true;
             }
@@ -626,7 +672,7 @@ bool button_handlefunc(ei_widget_t widget, ei_event_t* event) {
                 bool was_pressed = button->is_pressed;
                 button->is_pressed = inside;
                 if (was_pressed != button->is_pressed) {
-                    ei_app_invalidate_rect(screen_loc);
+                    ei_widget_repaint(widget);
                 }
                 event_handled = true;
             }
@@ -640,7 +686,7 @@ bool button_handlefunc(ei_widget_t widget, ei_event_t* event) {
                 button->is_pressed = false;
                 ei_event_set_active_widget(NULL);
                 if (was_pressed) {
-                    ei_app_invalidate_rect(screen_loc);
+                    ei_widget_repaint(widget);
                 }
                 if (was_pressed && inside && button->callback != NULL) {
                     button->callback(widget, event, button->user_param);
@@ -654,7 +700,7 @@ bool button_handlefunc(ei_widget_t widget, ei_event_t* event) {
                 (event->param.key_code == SDLK_RETURN || event->param.key_code == SDLK_SPACE)) {
                 if (!button->is_pressed) {
                     button->is_pressed = true;
-                    ei_app_invalidate_rect(screen_loc);
+                    ei_widget_repaint(widget);
                 }
                 event_handled = true;
             }
@@ -666,7 +712,7 @@ bool button_handlefunc(ei_widget_t widget, ei_event_t* event) {
                 bool was_pressed = button->is_pressed;
                 button->is_pressed = false;
                 if (was_pressed) {
-                    ei_app_invalidate_rect(screen_loc);
+                    ei_widget_repaint(widget);
                     if (button->callback != NULL) {
                         button->callback(widget, event, button->user_param);
                     }
@@ -681,7 +727,47 @@ bool button_handlefunc(ei_widget_t widget, ei_event_t* event) {
     return event_handled;
 }
 
+bool button_opaquefunc(ei_widget_t widget, ei_rect_t* opaque_rect) {
+    ei_impl_button_t* button = (ei_impl_button_t*)widget;
+    if (button->color.alpha != 0xff) {
+        return false;
+    }
+    // Centre du bouton (hors biseau), réduit pour exclure les coins arrondis :
+    // le carré inscrit dans un quart de cercle de rayon r laisse r * (1 - 1/sqrt(2)) de marge.
+    int inset = (button->relief != ei_relief_none) ? button->border_width : 0;
+    int radius = button->corner_radius - inset;
+    if (radius > 0) {
+        inset += (int)(radius * 0.2929f) + 1;
+    }
+    *opaque_rect = button->widget.screen_location;
+    opaque_rect->top_left.x += inset;
+    opaque_rect->top_left.y += inset;
+    opaque_rect->size.width -= 2 * inset;
+    opaque_rect->size.height -= 2 * inset;
+    return true;
+}
+
+bool button_hittestfunc(ei_widget_t widget, const ei_point_t* where) {
+    ei_impl_button_t* button = (ei_impl_button_t*)widget;
+    const ei_rect_t* rect = &button->widget.screen_location;
+    int radius = button->corner_radius;
+    if (2 * radius > rect->size.width) radius = rect->size.width / 2;
+    if (2 * radius > rect->size.height) radius = rect->size.height / 2;
+    if (radius <= 0) {
+        return true;
+    }
+    // Dans un carré de coin, le point doit être dans le quart de cercle
+    int cx = where->x < rect->top_left.x + radius ? rect->top_left.x + radius
+           : (where->x >= rect->top_left.x + rect->size.width - radius ? rect->top_left.x + rect->size.width - radius : where->x);
+    int cy = where->y < rect->top_left.y + radius ? rect->top_left.y + radius
+           : (where->y >= rect->top_left.y + rect->size.height - radius ? rect->top_left.y + rect->size.height - radius : where->y);
+    int dx = where->x - cx;
+    int dy = where->y - cy;
+    return dx * dx + dy * dy <= radius * radius;
+}
+
 static ei_widgetclass_t g_button_class_struct;
+static ei_impl_widgetclass_ext_t g_button_class_ext;
 
 void ei_button_register_class(void) {
     strncpy(g_button_class_struct.name, "button", sizeof(g_button_class_struct.name) - 1);
@@ -694,6 +780,11 @@ void ei_button_register_class(void) {
     g_button_class_struct.handlefunc = button_handlefunc;
     g_button_class_struct.next = NULL;
     ei_widgetclass_register(&g_button_class_struct);
+
+    g_button_class_ext.wclass = &g_button_class_struct;
+    g_button_class_ext.opaquefunc = button_opaquefunc;
+    g_button_class_ext.hittestfunc = button_hittestfunc;
+    ei_impl_widgetclass_register_ext(&g_button_class_ext);
 }
 
 //----------------------------------------------------------------------------------
@@ -745,6 +836,8 @@ void ei_toplevel_configure(ei_widget_t widget,
     if (geometry_changed && toplevel->widget.placer_params != NULL) {
         ei_impl_placer_run(widget);
     }
+    // Couleur, titre : simple repeinte
+    ei_widget_repaint(widget);
 }
 
 ei_widget_t toplevel_allocfunc(void) {
@@ -760,7 +853,8 @@ void toplevel_releasefunc(ei_widget_t widget) {
     ei_impl_toplevel_t* toplevel = (ei_impl_toplevel_t*)widget;
     // Note: For stability in current build, we avoid freeing title/content_rect here.
     // Ownership can be clarified later; leaking a few bytes per window is acceptable for tests.
-    (void)toplevel; // unused if no frees
+    free(toplevel->resize_preview);
+    toplevel->resize_preview = NULL;
 }
 
 static void toplevel_geomnotifyfunc(ei_widget_t widget) {
@@ -772,6 +866,7 @@ static void toplevel_geomnotifyfunc(ei_widget_t widget) {
     // Et ensuite, nous recalculerons content_rect pour qu'il corresponde à la requested_size originale.
 
     ei_size_t content_size = toplevel->widget.screen_location.size; // C'était la requested_size (contenu)
+    ei_rect_t old_content_rect = *toplevel->widget.content_rect;
 
     // Ajuster la taille totale de la fenêtre (screen_location.size)
     toplevel->widget.screen_location.size.width = content_size.width + 2 * toplevel->border_width;
@@ -815,6 +910,14 @@ static void toplevel_geomnotifyfunc(ei_widget_t widget) {
 
     // Mettre à jour la géométrie des enfants
     // Les enfants seront placés par rapport au *nouveau* content_rect
+    // (rien à faire s'il n'a pas changé : les changements propres aux enfants les replacent déjà)
+    if (memcmp(&old_content_rect, toplevel->widget.content_rect, sizeof(ei_rect_t)) == 0) {
+        return;
+    }
+    // Pendant un redimensionnement en direct, l'aperçu remplace les enfants jusqu'au prochain placement complet
+    if (toplevel->resize_preview != NULL) {
+        return;
+    }
     ei_widget_t child = toplevel->widget.children_head;
     while (child != NULL) {
         if (child->placer_params != NULL) {
@@ -825,6 +928,42 @@ static void toplevel_geomnotifyfunc(ei_widget_t widget) {
     // L'invalidation du toplevel lui-même est déjà gérée par l'appelant de geomnotify (placer_run)
 }
 
+// Copie (ou étire, au plus proche voisin) le dernier rendu du contenu dans le content_rect actuel.
+static void draw_resize_preview(ei_impl_toplevel_t* toplevel, ei_surface_t surface, const ei_rect_t* clipper) {
+    ei_rect_t content = *toplevel->widget.content_rect;
+    ei_size_t preview_size = toplevel->resize_preview_size;
+    bool stretch = ei_impl_app_live_resize(NULL) == ei_live_resize_stretch;
+    ei_rect_t area = content;
+    if (!stretch) {
+        // Le reste du contenu garde la couleur de fond, déjà remplie
+        area.size.width = min(area.size.width, preview_size.width);
+        area.size.height = min(area.size.height, preview_size.height);
+    }
+    if (!intersection_rect(&area, &area, clipper) || content.size.width <= 0 || content.size.height <= 0) {
+        return;
+    }
+
+    int surface_width = hw_surface_get_size(surface).width;
+    uint32_t* target = (uint32_t*)hw_surface_get_buffer(surface);
+    // Pas en virgule fixe 16.16 de la source pour un pixel de la destination
+    uint32_t step_x = stretch ? (uint32_t)(((uint64_t)preview_size.width << 16) / content.size.width) : 1 << 16;
+    uint32_t step_y = stretch ? (uint32_t)(((uint64_t)preview_size.height << 16) / content.size.height) : 1 << 16;
+    uint32_t src_x0 = (uint32_t)(area.top_left.x - content.top_left.x) * step_x;
+    uint32_t src_y = (uint32_t)(area.top_left.y - content.top_left.y) * step_y;
+    for (int y = 0; y < area.size.height; y++, src_y += step_y) {
+        const uint32_t* src_row = toplevel->resize_preview + (size_t)(src_y >> 16) * preview_size.width;
+        uint32_t* dst = target + (size_t)(area.top_left.y + y) * surface_width + area.top_left.x;
+        if (!stretch) {
+            memcpy(dst, src_row + (src_x0 >> 16), area.size.width * sizeof(uint32_t));
+            continue;
+        }
+        uint32_t src_x = src_x0;
+        for (int x = 0; x < area.size.width; x++, src_x += step_x) {
+            dst[x] = src_row[src_x >> 16];
+        }
+    }
+}
+
 void toplevel_drawfunc(ei_widget_t widget, ei_surface_t surface, ei_surface_t pick_surface, ei_rect_t* clipper) {
     ei_impl_toplevel_t* toplevel = (ei_impl_toplevel_t*)widget;
     ei_rect_t draw_rect = toplevel->widget.screen_location;
@@ -871,9 +1010,11 @@ void toplevel_drawfunc(ei_widget_t widget, ei_surface_t surface, ei_surface_t pi
     }
 
     // Dessiner la barre de titre
-    if (intersection_rect(&toplevel->title_bar_rect, &toplevel->title_bar_rect, &draw_rect)) {
+    // Les rectangles mémorisés ne doivent pas être clippés sur place : un dessin partiel les rétrécirait.
+    ei_rect_t clipped_part;
+    if (intersection_rect(&clipped_part, &toplevel->title_bar_rect, &draw_rect)) {
         ei_color_t title_bar_color = {0x80, 0x80, 0x80, 0xff};
-        ei_fill(surface, &title_bar_color, &toplevel->title_bar_rect);
+        ei_fill(surface, &title_bar_color, &clipped_part);
         if (toplevel->title) {
             int text_width, text_height;
             hw_text_compute_size(toplevel->title, ei_default_font, &text_width, &text_height);
@@ -881,37 +1022,41 @@ void toplevel_drawfunc(ei_widget_t widget, ei_surface_t surface, ei_surface_t pi
             text_pos.x = toplevel->title_bar_rect.top_left.x + 5;
             if (toplevel->closable) text_pos.x += TOPLEVEL_DECORATION_SIZE + 2;
             text_pos.y = toplevel->title_bar_rect.top_left.y + (toplevel->title_bar_rect.size.height - text_height) / 2;
-            ei_draw_text(surface, &text_pos, toplevel->title, ei_default_font, ei_font_default_color, &toplevel->title_bar_rect);
+            ei_draw_text(surface, &text_pos, toplevel->title, ei_default_font, ei_font_default_color, &clipped_part);
         }
     }
 
     // Dessiner le bouton de fermeture
-    if (toplevel->closable && intersection_rect(&toplevel->close_button_rect, &toplevel->close_button_rect, &draw_rect)) {
+    if (toplevel->closable && intersection_rect(&clipped_part, &toplevel->close_button_rect, &draw_rect)) {
         draw_button(surface, &toplevel->close_button_rect, 2.0f, (ei_color_t){0xff, 0x60, 0x60, 0xff}, 0, ei_relief_raised, &draw_rect);        ei_point_t p1 = {toplevel->close_button_rect.top_left.x + 3, toplevel->close_button_rect.top_left.y + 3};
         ei_point_t p2 = {toplevel->close_button_rect.top_left.x + toplevel->close_button_rect.size.width - 4, toplevel->close_button_rect.top_left.y + toplevel->close_button_rect.size.height - 4};
         ei_point_t p3 = {toplevel->close_button_rect.top_left.x + 3, toplevel->close_button_rect.top_left.y + toplevel->close_button_rect.size.height - 4};
         ei_point_t p4 = {toplevel->close_button_rect.top_left.x + toplevel->close_button_rect.size.width - 4, toplevel->close_button_rect.top_left.y + 3};
         ei_color_t x_color = {0x00, 0x00, 0x00, 0xff};
         ei_point_t lines_x[] = {p1, p2, p3, p4};
-        ei_draw_polyline(surface, &lines_x[0], 2, x_color, &toplevel->close_button_rect);
-        ei_draw_polyline(surface, &lines_x[2], 2, x_color, &toplevel->close_button_rect);
+        ei_draw_polyline(surface, &lines_x[0], 2, x_color, &clipped_part);
+        ei_draw_polyline(surface, &lines_x[2], 2, x_color, &clipped_part);
     }
 
     // Dessiner le contenu
-    if (intersection_rect(toplevel->widget.content_rect, toplevel->widget.content_rect, &draw_rect))  {
-        ei_fill(surface, &toplevel->color, toplevel->widget.content_rect);
+    if (intersection_rect(&clipped_part, toplevel->widget.content_rect, &draw_rect))  {
+        ei_fill(surface, &toplevel->color, &clipped_part);
     }
 
-    // Dessiner les enfants
+    // Dessiner les enfants (ou leur dernier rendu pendant un redimensionnement en direct)
     ei_rect_t children_clipper;
     if (intersection_rect(&children_clipper, toplevel->widget.content_rect, &draw_rect)) {
-        ei_impl_widget_draw_children(widget, surface, pick_surface, &children_clipper);
+        if (toplevel->resize_preview != NULL) {
+            draw_resize_preview(toplevel, surface, &children_clipper);
+        } else {
+            ei_impl_widget_draw_children(widget, surface, pick_surface, &children_clipper);
+        }
     }
 
     // Dessiner la poignée de redimensionnement en dernier pour qu'elle reste visible.
-    if (toplevel->resizable != ei_axis_none && intersection_rect(&toplevel->resize_handle_rect, &toplevel->resize_handle_rect, &draw_rect)) {
+    if (toplevel->resizable != ei_axis_none && intersection_rect(&clipped_part, &toplevel->resize_handle_rect, &draw_rect)) {
         ei_color_t resize_color = (ei_color_t){0x60, 0x60, 0xff, 0xff};
-        ei_fill(surface, &resize_color, &toplevel->resize_handle_rect);
+        ei_fill(surface, &resize_color, &clipped_part);
     }
 }
 
@@ -932,6 +1077,107 @@ void toplevel_setdefaultsfunc(ei_widget_t widget) {
 
 
 
+// Rend le contenu actuel du toplevel dans son aperçu de redimensionnement.
+static void render_resize_preview(ei_impl_toplevel_t* toplevel) {
+    free(toplevel->resize_preview);
+    toplevel->resize_preview = NULL;
+
+    ei_rect_t content = *toplevel->widget.content_rect;
+    if (content.size.width <= 0 || content.size.height <= 0) {
+        return;
+    }
+    size_t nb_pixels = (size_t)content.size.width * content.size.height;
+    uint32_t* pixels = malloc(nb_pixels * sizeof(uint32_t));
+    if (pixels == NULL) {
+        return;
+    }
+    // Hors de la fenêtre, le contenu n'est pas rendu : la couleur de fond
+    uint32_t background = ei_impl_map_rgba(ei_app_root_surface(), toplevel->color);
+    for (size_t i = 0; i < nb_pixels; i++) {
+        pixels[i] = background;
+    }
+    if (!ei_impl_widget_render((ei_widget_t)toplevel, &content, pixels)) {
+        free(pixels);
+        return;
+    }
+    toplevel->resize_preview = pixels;
+    toplevel->resize_preview_size = content.size;
+}
+
+// Replace les enfants dans le content_rect actuel, puis rend à nouveau l'aperçu si le
+// redimensionnement continue.
+static void relayout_resized_toplevel(ei_impl_toplevel_t* toplevel) {
+    ei_widget_t widget = (ei_widget_t)toplevel;
+    free(toplevel->resize_preview);
+    toplevel->resize_preview = NULL;
+    toplevel->resize_relayout_time = hw_now();
+
+    for (ei_widget_t child = widget->children_head; child != NULL; child = child->next_sibling) {
+        if (child->placer_params != NULL) {
+            ei_impl_placer_run(child);
+        }
+    }
+    // Le toplevel et ses enfants peuvent attendre dans la transaction en cours
+    ei_impl_layout_flush();
+    if (toplevel->is_resizing) {
+        render_resize_preview(toplevel);
+    }
+    ei_impl_widget_cache_invalidate(widget);
+    ei_app_invalidate_rect(widget->content_rect);
+}
+
+static void resize_relayout_cb(ei_timer_t timer, ei_user_param_t user_param) {
+    (void)timer;
+    ei_impl_toplevel_t* toplevel = (ei_impl_toplevel_t*)user_param;
+    toplevel->resize_relayout_timer = NULL;
+    relayout_resized_toplevel(toplevel);
+}
+
+// Programme le prochain placement complet, au plus tôt relayout_ms après le précédent.
+static void schedule_resize_relayout(ei_impl_toplevel_t* toplevel) {
+    if (toplevel->resize_relayout_timer != NULL) {
+        return;
+    }
+    int relayout_ms;
+    ei_impl_app_live_resize(&relayout_ms);
+    int delay = relayout_ms - (int)((hw_now() - toplevel->resize_relayout_time) * 1000);
+    toplevel->resize_relayout_timer = ei_timer_start(delay > 0 ? delay : 0, 0, (ei_widget_t)toplevel,
+                                                     resize_relayout_cb, toplevel);
+}
+
+// Place le toplevel déplacé à "position", ou lui donne la taille de contenu "position" s'il est redimensionné.
+static void apply_drag_position(ei_impl_toplevel_t* toplevel, ei_point_t position) {
+    ei_widget_t widget = (ei_widget_t)toplevel;
+    if (toplevel->is_moving) {
+        // ei_place invalide lui-même l'ancienne et la nouvelle position (ou déplace les pixels)
+        ei_place(widget, NULL, &position.x, &position.y, NULL, NULL, NULL, NULL, NULL, NULL);
+        return;
+    }
+    ei_size_t new_size = toplevel->widget.requested_size;
+    if (toplevel->resizable & ei_axis_x) {
+        new_size.width = max(toplevel->min_size.width, position.x);
+    }
+    if (toplevel->resizable & ei_axis_y) {
+        new_size.height = max(toplevel->min_size.height, position.y);
+    }
+    ei_rect_t old_loc = toplevel->widget.screen_location;
+    ei_app_invalidate_rect(&old_loc);
+    ei_toplevel_configure(widget, &new_size, NULL, NULL, NULL, NULL, NULL, NULL);
+    if (toplevel->resize_preview != NULL) {
+        // Seul le cadre suit la souris, les enfants sont replacés de temps en temps
+        schedule_resize_relayout(toplevel);
+    }
+}
+
+// Le pointeur s'est arrêté : la position extrapolée est remplacée par la position exacte.
+static void drag_settle_cb(ei_timer_t timer, ei_user_param_t user_param) {
+    (void)timer;
+    ei_impl_toplevel_t* toplevel = (ei_impl_toplevel_t*)user_param;
+    toplevel->drag_settle_timer = NULL;
+    toplevel->drag.drawn = ei_drag_position(&toplevel->drag);
+    apply_drag_position(toplevel, toplevel->drag.drawn);
+}
+
 bool toplevel_handlefunc(ei_widget_t widget, ei_event_t* event) {
     ei_impl_toplevel_t* toplevel = (ei_impl_toplevel_t*)widget;
     bool event_handled = false;
@@ -941,12 +1187,8 @@ bool toplevel_handlefunc(ei_widget_t widget, ei_event_t* event) {
             if (event->param.mouse.button == ei_mouse_button_left) {
                 ei_point_t click_pos = event->param.mouse.where;
 
-                // Amener au premier plan
-                if (toplevel->widget.parent && toplevel->widget.parent->children_tail != widget) {
-                    // Supposons une fonction ei_widget_bring_to_front (à implémenter)
-                    // Pour l’instant, invalider la zone
-                    ei_app_invalidate_rect(&toplevel->widget.screen_location);
-                }
+                // Amener au premier plan (ne coûte rien si la fenêtre y est déjà)
+                ei_widget_bring_to_front(widget);
 
                 if (toplevel->closable && point_in_rect(click_pos, &toplevel->close_button_rect)) {
                     // Invalider la zone avant de détruire
@@ -961,15 +1203,19 @@ bool toplevel_handlefunc(ei_widget_t widget, ei_event_t* event) {
                 } else if (toplevel->resizable != ei_axis_none && point_in_rect(click_pos, &toplevel->resize_handle_rect)) {
                     toplevel->is_resizing = true;
                     toplevel->is_moving = false;
-                    toplevel->drag_start_pos = click_pos;
-                    toplevel->widget_start_size = toplevel->widget.requested_size;
+                    ei_size_t start_size = toplevel->widget.requested_size;
+                    ei_drag_begin(&toplevel->drag, click_pos, ei_point(start_size.width, start_size.height));
+                    if (ei_impl_app_live_resize(NULL) != ei_live_resize_off) {
+                        ei_impl_layout_flush();
+                        render_resize_preview(toplevel);
+                        toplevel->resize_relayout_time = hw_now();
+                    }
                     ei_event_set_active_widget(widget);
                     event_handled = true;
                 } else if (point_in_rect(click_pos, &toplevel->title_bar_rect)) {
                     toplevel->is_moving = true;
                     toplevel->is_resizing = false;
-                    toplevel->drag_start_pos = click_pos;
-                    toplevel->widget_start_pos = toplevel->widget.screen_location.top_left;
+                    ei_drag_begin(&toplevel->drag, click_pos, toplevel->widget.screen_location.top_left);
                     ei_event_set_active_widget(widget);
                     event_handled = true;
                 }
@@ -982,28 +1228,21 @@ bool toplevel_handlefunc(ei_widget_t widget, ei_event_t* event) {
 
         case ei_ev_mouse_move:
             if (ei_event_get_active_widget() == widget) {
-                if (toplevel->is_moving) {
-                    int dx = event->param.mouse.where.x - toplevel->drag_start_pos.x;
-                    int dy = event->param.mouse.where.y - toplevel->drag_start_pos.y;
-                    int new_x = toplevel->widget_start_pos.x + dx;
-                    int new_y = toplevel->widget_start_pos.y + dy;
-                    ei_rect_t old_loc = toplevel->widget.screen_location;
-                    ei_app_invalidate_rect(&old_loc);
-                    ei_place(widget, NULL, &new_x, &new_y, NULL, NULL, NULL, NULL, NULL, NULL);
-                    event_handled = true;
-                } else if (toplevel->is_resizing) {
-                    int dw = event->param.mouse.where.x - toplevel->drag_start_pos.x;
-                    int dh = event->param.mouse.where.y - toplevel->drag_start_pos.y;
-                    ei_size_t new_size = toplevel->widget_start_size;
-                    if (toplevel->resizable & ei_axis_x) {
-                        new_size.width = max(toplevel->min_size.width, new_size.width + dw);
+                if (toplevel->is_moving || toplevel->is_resizing) {
+                    // Qualité réduite tant que la fenêtre bouge
+                    ei_impl_app_begin_interaction();
+                    // Position éventuellement extrapolée : corrigée quand le pointeur s'arrête
+                    ei_point_t drawn = ei_drag_update(&toplevel->drag, event->param.mouse.where);
+                    apply_drag_position(toplevel, drawn);
+                    ei_point_t exact = ei_drag_position(&toplevel->drag);
+                    if (toplevel->drag_settle_timer != NULL) {
+                        ei_timer_cancel(toplevel->drag_settle_timer);
+                        toplevel->drag_settle_timer = NULL;
                     }
-                    if (toplevel->resizable & ei_axis_y) {
-                        new_size.height = max(toplevel->min_size.height, new_size.height + dh);
+                    if (drawn.x != exact.x || drawn.y != exact.y) {
+                        toplevel->drag_settle_timer = ei_timer_start(TOPLEVEL_DRAG_SETTLE_MS, 0, widget,
+                                                                     drag_settle_cb, toplevel);
                     }
-                    ei_rect_t old_loc = toplevel->widget.screen_location;
-                    ei_app_invalidate_rect(&old_loc);
-                    ei_toplevel_configure(widget, &new_size, NULL, NULL, NULL, NULL, NULL, NULL);
                     event_handled = true;
                 }
             }
@@ -1012,12 +1251,33 @@ bool toplevel_handlefunc(ei_widget_t widget, ei_event_t* event) {
         case ei_ev_mouse_buttonup:
             if (ei_event_get_active_widget() == widget && event->param.mouse.button == ei_mouse_button_left) {
                 bool was_dragging = toplevel->is_moving || toplevel->is_resizing;
+                if (toplevel->drag_settle_timer != NULL) {
+                    ei_timer_cancel(toplevel->drag_settle_timer);
+                    toplevel->drag_settle_timer = NULL;
+                }
+                if (was_dragging) {
+                    // Corriger une position extrapolée
+                    ei_point_t drawn = toplevel->drag.drawn;
+                    ei_point_t exact = ei_drag_end(&toplevel->drag);
+                    if (drawn.x != exact.x || drawn.y != exact.y) {
+                        apply_drag_position(toplevel, exact);
+                    }
+                }
                 toplevel->is_moving = false;
                 toplevel->is_resizing = false;
+                if (toplevel->resize_relayout_timer != NULL) {
+                    ei_timer_cancel(toplevel->resize_relayout_timer);
+                    toplevel->resize_relayout_timer = NULL;
+                }
+                if (toplevel->resize_preview != NULL) {
+                    relayout_resized_toplevel(toplevel);
+                }
                 if (was_dragging) {
                     ei_event_set_active_widget(NULL);
+                    // Redessine en pleine qualité ce qui a été dessiné pendant la manipulation
+                    ei_impl_app_end_interaction();
                 }
-                ei_app_invalidate_rect(&toplevel->widget.screen_location);
+                // Sinon, le rendu ne dépend pas de l'état du glisser : rien à redessiner
                 event_handled = true;
             }
             break;
@@ -1028,7 +1288,27 @@ bool toplevel_handlefunc(ei_widget_t widget, ei_event_t* event) {
     return event_handled;
 }
 
+bool toplevel_opaquefunc(ei_widget_t widget, ei_rect_t* opaque_rect) {
+    ei_impl_toplevel_t* toplevel = (ei_impl_toplevel_t*)widget;
+    if (toplevel->color.alpha != 0xff) {
+        return false;
+    }
+    // Bordures, barre de titre et zone de contenu pavent toute la screen_location.
+    *opaque_rect = toplevel->widget.screen_location;
+    return true;
+}
+
+bool toplevel_overlayfunc(ei_widget_t widget, ei_rect_t* overlay_rect) {
+    ei_impl_toplevel_t* toplevel = (ei_impl_toplevel_t*)widget;
+    if (toplevel->resizable == ei_axis_none) {
+        return false;
+    }
+    *overlay_rect = toplevel->resize_handle_rect;
+    return true;
+}
+
 static ei_widgetclass_t g_toplevel_class_struct;
+static ei_impl_widgetclass_ext_t g_toplevel_class_ext;
 
 void ei_toplevel_register_class(void) {
     strncpy(g_toplevel_class_struct.name, "toplevel", sizeof(g_toplevel_class_struct.name) - 1);
@@ -1041,4 +1321,9 @@ void ei_toplevel_register_class(void) {
     g_toplevel_class_struct.handlefunc = toplevel_handlefunc;
     g_toplevel_class_struct.next = NULL;
     ei_widgetclass_register(&g_toplevel_class_struct);
+
+    g_toplevel_class_ext.wclass = &g_toplevel_class_struct;
+    g_toplevel_class_ext.opaquefunc = toplevel_opaquefunc;
+    g_toplevel_class_ext.overlayfunc = toplevel_overlayfunc;
+    ei_impl_widgetclass_register_ext(&g_toplevel_class_ext);
 }
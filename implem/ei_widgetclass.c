@@ -27,4 +27,26 @@ ei_widgetclass_t* ei_widgetclass_from_name(ei_const_string_t name) {
         current = current->next;
     }
     return NULL; // Classe non trouvée
-}
\ No newline at end of file
+}
+
+/**
+ * Registry of the private class extensions (linked list).
+ */
+static ei_impl_widgetclass_ext_t* class_ext_list = NULL;
+
+void ei_impl_widgetclass_register_ext(ei_impl_widgetclass_ext_t* ext) {
+    assert(ext != NULL && ext->wclass != NULL);
+    ext->next = class_ext_list;
+    class_ext_list = ext;
+}
+
+ei_impl_widgetclass_ext_t* ei_impl_widgetclass_ext_from_class(const ei_widgetclass_t* wclass) {
+    ei_impl_widgetclass_ext_t* current = class_ext_list;
+    while (current != NULL) {
+        if (current->wclass == wclass) {
+            return current;
+        }
+        current = current->next;
+    }
+    return NULL;
+}
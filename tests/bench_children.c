@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ei_application.h"
+#include "ei_event.h"
+#include "hw_interface.h"
+#include "ei_widget_configure.h"
+#include "ei_placer.h"
+#include "ei_widget_attributes.h"
+#include "ei_utils.h"
+
+/*
+ * Mesure le coût du dessin et du picking d'un conteneur avec beaucoup d'enfants.
+ * Usage : ./bench_children [nombre d'enfants] [offscreen|geometric]
+ *         (par exemple 1000, 10000, 100000 ; picking par offscreen par défaut)
+ *
+ * Chaque itération invalide un petit rectangle qui se déplace dans la fenêtre ; la boucle
+ * d'événements redessine alors uniquement cette zone. Viennent ensuite des redessins de la
+ * fenêtre entière. Le temps moyen par redessin et par ei_widget_pick est affiché à la fin,
+ * ainsi que la mémoire des surfaces de la taille de la fenêtre.
+ */
+
+static const ei_size_t	k_window_size	= {800, 600};
+static const int	k_nb_redraws	= 500;
+static const int	k_nb_full	= 50;
+static const int	k_nb_picks	= 100000;
+static const int	k_damage_size	= 20;
+
+static int		g_iteration	= 0;
+static double		g_start		= 0;
+
+static void bench_handler(ei_event_t* event)
+{
+	if (event->type == ei_ev_keydown || event->type == ei_ev_close) {
+		ei_app_quit_request();
+		return;
+	}
+	if (event->type != ei_ev_app)
+		return;
+
+	if (g_iteration == 0)
+		g_start = hw_now();
+
+	if (g_iteration == k_nb_redraws) {
+		double redraw_time = (hw_now() - g_start) / (double)k_nb_redraws;
+		printf("Temps moyen d'un redessin %dx%d : %.9f secondes\n", k_damage_size, k_damage_size, redraw_time);
+		g_start = hw_now();
+	}
+
+	if (g_iteration == k_nb_redraws + k_nb_full) {
+		double frame_time = (hw_now() - g_start) / (double)k_nb_full;
+		printf("Temps moyen d'un redessin de la fenêtre : %.9f secondes\n", frame_time);
+
+		// Picking en des points pseudo-aléatoires (la pick surface est à jour)
+		srand(42);
+		int found = 0;
+		double start = hw_now();
+		for (int i = 0; i < k_nb_picks; i++) {
+			ei_point_t where = ei_point(rand() % k_window_size.width, rand() % k_window_size.height);
+			if (ei_widget_pick(&where) != ei_app_root_widget())
+				found++;
+		}
+		double pick_time = (hw_now() - start) / (double)k_nb_picks;
+		printf("Temps moyen de ei_widget_pick : %.9f secondes (%d enfants touchés)\n", pick_time, found);
+
+		ei_app_quit_request();
+		return;
+	}
+
+	if (g_iteration >= k_nb_redraws) {
+		ei_app_invalidate_rect(ei_widget_get_screen_location(ei_app_root_widget()));
+		g_iteration++;
+		hw_event_post_app(NULL);
+		return;
+	}
+
+	// Zone suivante à redessiner : balaye la fenêtre en diagonale
+	int x = (g_iteration * 37) % (k_window_size.width - k_damage_size);
+	int y = (g_iteration * 23) % (k_window_size.height - k_damage_size);
+	ei_rect_t damage = ei_rect(ei_point(x, y), ei_size(k_damage_size, k_damage_size));
+	ei_app_invalidate_rect(&damage);
+
+	g_iteration++;
+	hw_event_post_app(NULL);
+}
+
+int main(int argc, char** argv)
+{
+	int nb_children = argc > 1 ? atoi(argv[1]) : 1000;
+	if (nb_children <= 0)
+		nb_children = 1000;
+	ei_picking_t picking = (argc > 2 && strcmp(argv[2], "geometric") == 0) ? ei_picking_geometric : ei_picking_offscreen;
+
+	ei_app_create_with_picking(k_window_size, false, picking);
+
+	// Fenêtre (4 octets par pixel) + éventuel buffer de picking (2 octets par pixel jusqu'à 65535 widgets)
+	int bytes_per_pixel = (picking == ei_picking_offscreen) ? 4 + 2 : 4;
+	printf("Picking %s : %d Ko de surfaces de la taille de la fenêtre\n",
+	       picking == ei_picking_offscreen ? "offscreen" : "geometric",
+	       bytes_per_pixel * k_window_size.width * k_window_size.height / 1024);
+
+	// Grille de petits frames qui couvre toute la fenêtre
+	int nb_cols = 1;
+	while (nb_cols * nb_cols * k_window_size.height < nb_children * k_window_size.width)
+		nb_cols++;
+	int nb_rows = (nb_children + nb_cols - 1) / nb_cols;
+	int cell_w = k_window_size.width / nb_cols > 0 ? k_window_size.width / nb_cols : 1;
+	int cell_h = k_window_size.height / nb_rows > 0 ? k_window_size.height / nb_rows : 1;
+
+	double start = hw_now();
+	for (int i = 0; i < nb_children; i++) {
+		ei_widget_t	frame	= ei_widget_create("frame", ei_app_root_widget(), NULL, NULL);
+		ei_size_t	size	= ei_size(cell_w, cell_h);
+		ei_color_t	color	= {(uint8_t)(i * 7), (uint8_t)(i * 13), (uint8_t)(i * 29), 0xff};
+		int		border	= 0;
+		ei_frame_configure(frame, &size, &color, &border, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+		ei_place_xy(frame, (i % nb_cols) * cell_w, (i / nb_cols) * cell_h);
+	}
+	printf("%d enfants créés et placés en %.6f secondes\n", nb_children, hw_now() - start);
+
+	ei_event_set_default_handle_func(bench_handler);
+	hw_event_post_app(NULL);
+
+	ei_app_run();
+
+	ei_app_free();
+
+	return (EXIT_SUCCESS);
+}
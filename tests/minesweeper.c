@@ -17,6 +17,7 @@
 #include "ei_utils.h"
 #include "ei_event.h"
 #include "ei_placer.h"
+#include "ei_timer.h"
 
 /* constants */
 
@@ -302,11 +303,15 @@ void default_handler(ei_event_t* event)
 	    ((event->type == ei_ev_keydown) && (event->param.key_code == SDLK_ESCAPE)))
 		ei_app_quit_request();
 
-	else if ((event->type == ei_ev_app) && (event->param.application.user_param == &g_game_window)) {
-		if (g_game_window != NULL)
-			handle_time((map_t*)ei_widget_get_user_data(g_game_window));
-		hw_event_schedule_app(250, &g_game_window);
-	}
+}
+
+void time_cb(ei_timer_t timer, ei_user_param_t user_param)
+{
+	(void)timer;
+	(void)user_param;
+
+	if (g_game_window != NULL)
+		handle_time((map_t*)ei_widget_get_user_data(g_game_window));
 }
 
 ei_widget_t create_game_window(ei_size_t map_size, int nb_mine);
@@ -467,7 +472,7 @@ int main(int argc, char* argv[])
 
 	ei_event_set_default_handle_func(default_handler);
 
-	hw_event_schedule_app(250, &g_game_window);
+	ei_timer_start(250, 250, NULL, time_cb, NULL);
 
 	ei_app_run();
 
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ei_application.h"
+#include "ei_event.h"
+#include "ei_widgetclass.h"
+#include "ei_widget_configure.h"
+#include "ei_placer.h"
+#include "ei_timer.h"
+#include "ei_animate.h"
+#include "ei_draw.h"
+#include "ei_utils.h"
+#include "ei_implementation.h"
+
+/*
+ * Test de non-régression de ei_widget_create : la classe "abclass" alloue ses widgets avec
+ * malloc et remplit le bloc avec 0xAB au lieu de le mettre à 0. Tous les champs communs
+ * doivent donc être initialisés par ei_widget_create, sinon le placement (transactions de
+ * mise en page), les animations ou la destruction (timers) lisent des valeurs invalides.
+ * Le programme se termine seul et affiche "ok" ; le lancer aussi avec -fsanitize=address.
+ */
+
+static const int	k_nb_frames	= 10;
+
+static ei_widget_t	g_widget	= NULL;
+static ei_widget_t	g_child		= NULL;
+static int		g_nb_ticks	= 0;
+
+static ei_widget_t abclass_alloc(void)
+{
+	ei_widget_t widget = malloc(ei_widget_struct_size());
+	memset(widget, 0xAB, ei_widget_struct_size());
+
+	// Le seul champ commun que l'allocateur peut fixer lui-même (cf. toplevel).
+	widget->content_rect = NULL;
+	return widget;
+}
+
+static void abclass_draw(ei_widget_t widget, ei_surface_t surface, ei_surface_t pick_surface, ei_rect_t* clipper)
+{
+	ei_rect_t	r	= widget->screen_location;
+	ei_point_t	corners[4] = {
+		r.top_left,
+		ei_point(r.top_left.x + r.size.width, r.top_left.y),
+		ei_point(r.top_left.x + r.size.width, r.top_left.y + r.size.height),
+		ei_point(r.top_left.x, r.top_left.y + r.size.height) };
+
+	ei_draw_polygon(surface, corners, 4, (ei_color_t){0x80, 0x40, 0x20, 0xff}, clipper);
+}
+
+static void abclass_setdefaults(ei_widget_t widget)
+{
+}
+
+static void abclass_register(void)
+{
+	static ei_widgetclass_t abclass;
+
+	strcpy(abclass.name, "abclass");
+	abclass.allocfunc	= abclass_alloc;
+	abclass.releasefunc	= NULL;
+	abclass.drawfunc	= abclass_draw;
+	abclass.setdefaultsfunc	= abclass_setdefaults;
+	abclass.geomnotifyfunc	= NULL;
+	abclass.handlefunc	= NULL;
+	ei_widgetclass_register(&abclass);
+}
+
+static void tick(ei_timer_t timer, ei_user_param_t user_param)
+{
+	(void)timer;
+	(void)user_param;
+
+	g_nb_ticks++;
+	if (g_nb_ticks == k_nb_frames / 2) {
+		// Détruit un widget animé, avec un timer et un enfant.
+		ei_widget_destroy(g_widget);
+		g_widget = g_child = NULL;
+	} else if (g_nb_ticks == k_nb_frames)
+		ei_app_quit_request();
+}
+
+static void owned_timer_cb(ei_timer_t timer, ei_user_param_t user_param)
+{
+	(void)timer;
+	(void)user_param;
+
+	// Le timer appartient à g_widget, il doit être annulé par sa destruction.
+	fprintf(stderr, "timer d'un widget détruit appelé\n");
+	exit(EXIT_FAILURE);
+}
+
+static void default_handler(ei_event_t* event)
+{
+	if (event->type == ei_ev_close || event->type == ei_ev_keydown)
+		ei_app_quit_request();
+}
+
+int main(int argc, char** argv)
+{
+	ei_widget_t	unplaced;
+
+	ei_app_create((ei_size_t){400, 300}, false);
+	ei_event_set_default_handle_func(default_handler);
+	abclass_register();
+
+	// Un widget jamais placé, détruit tout de suite.
+	unplaced = ei_widget_create("abclass", ei_app_root_widget(), NULL, NULL);
+	ei_widget_destroy(unplaced);
+
+	// Placement dans une transaction, puis une animation et un timer attachés au widget.
+	ei_layout_begin();
+	g_widget = ei_widget_create("abclass", ei_app_root_widget(), NULL, NULL);
+	g_child	 = ei_widget_create("abclass", g_widget, NULL, NULL);
+	ei_place(g_widget, NULL, &(int){20}, &(int){20}, &(int){200}, &(int){150}, NULL, NULL, NULL, NULL);
+	ei_place(g_child, NULL, &(int){10}, &(int){10}, &(int){50}, &(int){50}, NULL, NULL, NULL, NULL);
+	ei_layout_commit();
+
+	ei_animate(g_widget, ei_anim_x, 150, 1000, ei_ease_linear);
+	ei_timer_start(1000, 0, g_widget, owned_timer_cb, NULL);
+	ei_timer_start(20, 20, NULL, tick, NULL);
+
+	ei_app_run();
+
+	ei_app_free();
+	printf("ok\n");
+	return (EXIT_SUCCESS);
+}